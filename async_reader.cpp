@@ -0,0 +1,350 @@
+#include "async_reader.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define LAB07_IO_URING 1
+#endif
+#endif
+
+#if defined(LAB07_IO_URING)
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#if defined(LAB07_IO_URING)
+constexpr size_t directAlignment = 4096; // выравнивание смещений и длин чтений O_DIRECT
+
+// Кольцо io_uring, работа с которым идет напрямую через системные вызовы (без liburing)
+class IoUring {
+public:
+    ~IoUring() {
+        if (sqes_ != nullptr) ::munmap(sqes_, sqesSize_);
+        if (cqRing_ != nullptr && cqRing_ != sqRing_) ::munmap(cqRing_, cqRingSize_);
+        if (sqRing_ != nullptr) ::munmap(sqRing_, sqRingSize_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    // Создание кольца; возвращает false, если ядро не поддерживает io_uring или запрещает его
+    bool setup(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) {
+            return false;
+        }
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) { // очереди отправки и завершения в одном отображении
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        }
+        sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED) {
+            sqRing_ = nullptr;
+            return false;
+        }
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            cqRing_ = sqRing_;
+        } else {
+            cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+            if (cqRing_ == MAP_FAILED) {
+                cqRing_ = nullptr;
+                return false;
+            }
+        }
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+        char* sq = static_cast<char*>(sqRing_);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        char* cq = static_cast<char*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // Регистрация буферов для IORING_OP_READ_FIXED
+    bool registerBuffers(const std::vector<iovec>& buffers) {
+        return ::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, buffers.data(), static_cast<unsigned>(buffers.size())) == 0;
+    }
+
+    // Следующий свободный элемент очереди отправки (вызывающий следит, чтобы очередь не переполнялась)
+    io_uring_sqe* nextSqe() {
+        unsigned tail = *sqTail_;
+        unsigned index = tail & sqMask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray_[index] = index;
+        __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE); // ядро увидит заполненный элемент после io_uring_enter
+        return sqe;
+    }
+
+    // Отправка submitCount подготовленных запросов и ожидание хотя бы одного завершения; возвращает количество отправленных
+    unsigned submitAndWait(unsigned submitCount) {
+        while (true) {
+            long result = ::syscall(__NR_io_uring_enter, fd_, submitCount, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (result >= 0) {
+                return static_cast<unsigned>(result);
+            }
+            if (errno != EINTR) {
+                throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+            }
+        }
+    }
+
+    // Перебор завершенных запросов
+    template <typename OnCompletion>
+    void reap(OnCompletion onCompletion) {
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            io_uring_cqe cqe = cqes_[head & cqMask_];
+            __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE); // элемент скопирован, ядро может его переиспользовать
+            onCompletion(cqe);
+        }
+    }
+
+private:
+    int fd_ = -1;
+    void* sqRing_ = nullptr;
+    size_t sqRingSize_ = 0;
+    void* cqRing_ = nullptr;
+    size_t cqRingSize_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqesSize_ = 0;
+    unsigned* sqTail_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned* sqArray_ = nullptr;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+// Читатель на io_uring: файлы открываются в вызывающем потоке, чтения всех открытых файлов идут параллельно
+class UringReader : public AsyncReader {
+public:
+    ~UringReader() override {
+        if (memory_ != nullptr) ::munmap(memory_, memorySize_);
+    }
+
+    bool init(size_t queueDepth, size_t bufferCount, size_t bufferSize) {
+        static const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        queueDepth_ = std::max<size_t>(queueDepth, 1);
+        bufferSize_ = (bufferSize + pageSize - 1) / pageSize * pageSize; // буферы выровнены по странице
+        bufferCount = std::max(bufferCount, queueDepth_);
+        if (!ring_.setup(static_cast<unsigned>(queueDepth_))) {
+            return false;
+        }
+        memorySize_ = bufferCount * bufferSize_;
+        void* memory = ::mmap(nullptr, memorySize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            return false;
+        }
+        memory_ = static_cast<unsigned char*>(memory);
+        for (size_t i = 0; i < bufferCount; ++i) {
+            buffers_.push_back({memory_ + i * bufferSize_, bufferSize_});
+            freeBuffers_.push_back(bufferCount - 1 - i);
+        }
+        slots_.resize(bufferCount);
+        fixedBuffers_ = ring_.registerBuffers(buffers_); // при нехватке RLIMIT_MEMLOCK читаем в те же буферы через readv
+        return true;
+    }
+
+    void read(size_t requestCount, const RequestSource& request, const CompletionHandler& onRead) override {
+        size_t next = 0; // следующий запрос
+        size_t inFlight = 0; // отправленные, но не завершенные чтения
+        unsigned prepared = 0; // подготовленные, но не отправленные чтения
+        std::deque<std::pair<size_t, Request>> deferred; // запросы, устройство которых было занято (по порядку номеров)
+        std::unordered_map<uint64_t, size_t> laneActive; // чтения в работе по устройствам
+        auto hasRoom = [&laneActive](const Request& item) { return item.laneLimit == 0 || laneActive[item.lane] < item.laneLimit; };
+        std::exception_ptr error; // первое исключение обработчика; после него новые чтения не начинаются
+        auto handle = [&](const Completion& completion) {
+            if (error) {
+                if (completion.data != nullptr) {
+                    release(completion.buffer);
+                }
+                return;
+            }
+            try {
+                onRead(completion);
+            } catch (...) {
+                error = std::current_exception();
+            }
+        };
+        while (((next < requestCount || !deferred.empty()) && !error) || inFlight + prepared > 0) {
+            while ((next < requestCount || !deferred.empty()) && !error && inFlight + prepared < queueDepth_) {
+                size_t buffer;
+                if (!acquire(buffer, inFlight + prepared == 0)) { // все буферы у обработчиков, ждать можно только завершений
+                    break;
+                }
+                size_t index = requestCount; // выбранный запрос (requestCount - все устройства заняты)
+                Request item;
+                for (auto it = deferred.begin(); it != deferred.end(); ++it) { // сначала отложенные: они раньше по порядку
+                    if (hasRoom(it->second)) {
+                        index = it->first;
+                        item = std::move(it->second);
+                        deferred.erase(it);
+                        break;
+                    }
+                }
+                while (index == requestCount && next < requestCount && deferred.size() < queueDepth_) {
+                    Request candidate = request(next);
+                    if (hasRoom(candidate)) {
+                        index = next;
+                        item = std::move(candidate);
+                    } else {
+                        deferred.emplace_back(next, std::move(candidate));
+                    }
+                    ++next;
+                }
+                if (index == requestCount) { // ждем завершения чтений занятых устройств
+                    release(buffer);
+                    break;
+                }
+                const bool direct = item.direct && item.offset % directAlignment == 0;
+                int fd = direct ? ::open(item.path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT) : -1;
+                if (!direct || (fd < 0 && errno == EINVAL)) { // файловая система без O_DIRECT читается через кэш
+                    fd = ::open(item.path.c_str(), O_RDONLY | O_CLOEXEC);
+                }
+                if (fd < 0) {
+                    int openError = errno;
+                    release(buffer);
+                    handle({index, nullptr, 0, openError, 0});
+                    continue;
+                }
+                ++laneActive[item.lane];
+                Slot& slot = slots_[buffer];
+                const size_t length = std::min(item.length, bufferSize_);
+                slot = {index, fd, {}, item.lane, length};
+                // Длина чтения O_DIRECT кратна выравниванию (буферы выровнены по странице и имеют размер, кратный ей), лишнее отбрасывается
+                const size_t readLength = direct ? std::min((length + directAlignment - 1) / directAlignment * directAlignment, bufferSize_) : length;
+                io_uring_sqe* sqe = ring_.nextSqe();
+                sqe->fd = fd;
+                sqe->off = item.offset;
+                sqe->user_data = buffer;
+                if (fixedBuffers_) {
+                    sqe->opcode = IORING_OP_READ_FIXED;
+                    sqe->addr = reinterpret_cast<uint64_t>(buffers_[buffer].iov_base);
+                    sqe->len = static_cast<uint32_t>(readLength);
+                    sqe->buf_index = static_cast<uint16_t>(buffer);
+                } else {
+                    slot.iov = {buffers_[buffer].iov_base, readLength};
+                    sqe->opcode = IORING_OP_READV;
+                    sqe->addr = reinterpret_cast<uint64_t>(&slot.iov);
+                    sqe->len = 1;
+                }
+                ++prepared;
+            }
+            if (inFlight + prepared == 0) {
+                continue;
+            }
+            unsigned submitted = ring_.submitAndWait(prepared);
+            prepared -= submitted;
+            inFlight += submitted;
+            ring_.reap([&](const io_uring_cqe& cqe) {
+                size_t buffer = static_cast<size_t>(cqe.user_data);
+                Slot& slot = slots_[buffer];
+                ::close(slot.fd);
+                --inFlight;
+                --laneActive[slot.lane];
+                if (cqe.res < 0) {
+                    release(buffer);
+                    handle({slot.request, nullptr, 0, -cqe.res, 0});
+                } else {
+                    handle({slot.request, static_cast<unsigned char*>(buffers_[buffer].iov_base), std::min(static_cast<size_t>(cqe.res), slot.length), 0, buffer});
+                }
+            });
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    void release(size_t buffer) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            freeBuffers_.push_back(buffer);
+        }
+        bufferReleased_.notify_one();
+    }
+
+    size_t bufferSize() const override { return bufferSize_; }
+
+private:
+    // Чтение, занимающее буфер
+    struct Slot {
+        size_t request = 0; // номер запроса
+        int fd = -1; // открытый файл
+        iovec iov{}; // описание буфера для IORING_OP_READV
+        uint64_t lane = 0; // устройство файла
+        size_t length = 0; // запрошенная длина
+    };
+
+    // Захват свободного буфера; при wait == true ожидает, пока обработчик вернет буфер
+    bool acquire(size_t& buffer, bool wait) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (wait) {
+            bufferReleased_.wait(lock, [this] { return !freeBuffers_.empty(); });
+        } else if (freeBuffers_.empty()) {
+            return false;
+        }
+        buffer = freeBuffers_.back();
+        freeBuffers_.pop_back();
+        return true;
+    }
+
+    IoUring ring_;
+    size_t queueDepth_ = 0; // максимальное количество одновременных чтений
+    size_t bufferSize_ = 0;
+    unsigned char* memory_ = nullptr; // память всех буферов
+    size_t memorySize_ = 0;
+    std::vector<iovec> buffers_; // буферы пула
+    bool fixedBuffers_ = false; // буферы зарегистрированы в ядре
+    std::vector<Slot> slots_; // чтения по номерам буферов
+    std::mutex mutex_;
+    std::condition_variable bufferReleased_;
+    std::vector<size_t> freeBuffers_; // свободные буферы
+};
+#endif
+
+} // namespace
+
+std::unique_ptr<AsyncReader> AsyncReader::create(size_t queueDepth, size_t bufferCount, size_t bufferSize) {
+#if defined(LAB07_IO_URING)
+    std::unique_ptr<UringReader> reader(new UringReader());
+    if (reader->init(queueDepth, bufferCount, bufferSize)) {
+        return reader;
+    }
+#else
+    (void)queueDepth;
+    (void)bufferCount;
+    (void)bufferSize;
+#endif
+    return nullptr;
+}
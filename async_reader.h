@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+
+// Асинхронное чтение участков многих файлов: на Linux - через io_uring с зарегистрированным пулом буферов,
+// так что в работе одновременно находится до queueDepth чтений. Прочитанные буферы передаются обработчику
+// (обычно он отдает их рабочим потокам хэширования) и возвращаются в пул вызовом release из любого потока.
+// На других ОС и ядрах без io_uring create возвращает nullptr, и чтение выполняет пул потоков
+class AsyncReader {
+public:
+    // Запрос на чтение участка файла
+    struct Request {
+        std::filesystem::path path; // файл
+        uint64_t offset = 0; // смещение участка
+        size_t length = 0; // длина участка (не больше размера буфера)
+        uint64_t lane = 0; // устройство файла: одновременных чтений одного устройства не больше laneLimit
+        size_t laneLimit = 0; // 0 - без ограничения
+        bool direct = false; // читать в обход страничного кэша (O_DIRECT; offset кратен 4 КиБ), если файловая система это позволяет
+    };
+
+    // Результат чтения
+    struct Completion {
+        size_t request; // номер запроса
+        unsigned char* data; // прочитанные данные (nullptr при ошибке)
+        size_t size; // количество прочитанных байтов (меньше length у конца файла)
+        int error; // код ошибки errno (0 - успешно)
+        size_t buffer; // номер буфера для release
+    };
+
+    using RequestSource = std::function<Request(size_t index)>;
+    using CompletionHandler = std::function<void(const Completion& completion)>;
+
+    virtual ~AsyncReader() = default;
+
+    // Создание читателя с очередью глубины queueDepth и bufferCount буферами по bufferSize байтов; nullptr - io_uring недоступен
+    static std::unique_ptr<AsyncReader> create(size_t queueDepth, size_t bufferCount, size_t bufferSize);
+
+    // Чтение requestCount участков; onRead вызывается в вызывающем потоке по мере завершения чтений.
+    // Запросы отправляются по порядку; запрос, устройство которого занято, откладывается (не больше queueDepth запросов),
+    // а следующие за ним запросы других устройств отправляются раньше него.
+    // Каждый успешно прочитанный буфер нужно вернуть вызовом release, иначе новые чтения не начнутся
+    virtual void read(size_t requestCount, const RequestSource& request, const CompletionHandler& onRead) = 0;
+    // Возвращение буфера в пул
+    virtual void release(size_t buffer) = 0;
+    // Размер буфера
+    virtual size_t bufferSize() const = 0;
+};
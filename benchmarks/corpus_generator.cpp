@@ -0,0 +1,158 @@
+#include "corpus_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr const char* extensions[] = {".bin", ".txt", ".jpg", ".log"};
+
+// План одного файла набора
+struct FilePlan {
+    uint64_t size; // размер
+    uint64_t contentSeed; // начальное значение генератора содержимого
+    uint64_t mutateAt; // номер измененного байта (UINT64_MAX - без изменения)
+    size_t extension; // номер расширения имени
+};
+
+// Генератор содержимого xorshift64*: быстрый и одинаковый на всех платформах
+class ContentGenerator {
+public:
+    explicit ContentGenerator(uint64_t seed) : state_(seed | 1) {}
+
+    uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545F4914F6CDD1Dull;
+    }
+
+private:
+    uint64_t state_;
+};
+
+// Функция для построения плана набора (без обращения к файловой системе)
+std::vector<FilePlan> planCorpus(const CorpusSpec& spec, CorpusInfo& info) {
+    std::mt19937_64 random(spec.seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const double logMin = std::log(static_cast<double>(std::max<uint64_t>(spec.minSize, 1)));
+    const double logMax = std::log(static_cast<double>(std::max(spec.maxSize, std::max<uint64_t>(spec.minSize, 1))));
+    std::vector<FilePlan> plan;
+    std::vector<size_t> originals; // файлы с собственным содержимым
+    info = CorpusInfo();
+    for (size_t i = 0; i < spec.fileCount; ++i) {
+        double kind = unit(random);
+        FilePlan file{0, 0, UINT64_MAX, static_cast<size_t>(random() % (sizeof(extensions) / sizeof(extensions[0])))};
+        if (!originals.empty() && kind < spec.duplicateRatio) { // точная копия
+            const FilePlan& source = plan[originals[random() % originals.size()]];
+            file.size = source.size;
+            file.contentSeed = source.contentSeed;
+            ++info.duplicates;
+        } else if (!originals.empty() && kind < spec.duplicateRatio + spec.sharedPrefixRatio) { // копия с одним измененным байтом
+            const FilePlan& source = plan[originals[random() % originals.size()]];
+            file.size = source.size;
+            file.contentSeed = source.contentSeed;
+            if (file.size >= 4) { // отличие в последней четверти файла
+                file.mutateAt = file.size - 1 - random() % (file.size / 4);
+                ++info.sharedPrefix;
+            } else {
+                ++info.duplicates;
+            }
+        } else {
+            file.size = spec.minSize == spec.maxSize ? spec.minSize : static_cast<uint64_t>(std::exp(logMin + (logMax - logMin) * unit(random)));
+            file.size = std::min(std::max(file.size, spec.minSize), spec.maxSize);
+            file.contentSeed = random();
+            originals.push_back(plan.size());
+        }
+        info.bytes += file.size;
+        plan.push_back(file);
+    }
+    info.files = plan.size();
+    return plan;
+}
+
+// Функция для получения описания параметров набора (хранится рядом с набором)
+std::string describe(const CorpusSpec& spec) {
+    std::ostringstream out;
+    out << "version=1 files=" << spec.fileCount << " perDirectory=" << spec.filesPerDirectory << " perGroup=" << spec.directoriesPerGroup
+        << " minSize=" << spec.minSize << " maxSize=" << spec.maxSize << " duplicates=" << spec.duplicateRatio
+        << " sharedPrefix=" << spec.sharedPrefixRatio << " seed=" << spec.seed;
+    return out.str();
+}
+
+// Функция для записи содержимого файла по плану
+void writeFile(const fs::path& path, const FilePlan& file) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot create file: " + path.string());
+    }
+    ContentGenerator generator(file.contentSeed);
+    std::vector<unsigned char> buffer(64 * 1024);
+    for (uint64_t offset = 0; offset < file.size;) {
+        size_t size = static_cast<size_t>(std::min<uint64_t>(buffer.size(), file.size - offset));
+        for (size_t i = 0; i < size; i += 8) {
+            uint64_t value = generator.next();
+            for (size_t j = 0; j < 8 && i + j < size; ++j) {
+                buffer[i + j] = static_cast<unsigned char>(value >> (8 * j));
+            }
+        }
+        if (file.mutateAt >= offset && file.mutateAt < offset + size) {
+            buffer[static_cast<size_t>(file.mutateAt - offset)] ^= 0xFF;
+        }
+        out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(size));
+        offset += size;
+    }
+    if (!out.flush()) {
+        throw std::runtime_error("Cannot write file: " + path.string());
+    }
+}
+
+} // namespace
+
+CorpusInfo generateCorpus(const fs::path& root, const CorpusSpec& spec) {
+    CorpusInfo info;
+    std::vector<FilePlan> plan = planCorpus(spec, info);
+    fs::path directory = root.lexically_normal();
+    if (!directory.has_filename()) { // "corpus/" -> "corpus"
+        directory = directory.parent_path();
+    }
+    fs::path marker = directory;
+    marker += ".spec"; // описание лежит рядом с набором, чтобы не попадать в обход
+    const std::string description = describe(spec);
+    std::error_code error;
+    {
+        std::ifstream in(marker);
+        std::string existing;
+        if (std::getline(in, existing) && existing == description && fs::is_directory(directory, error)) {
+            return info;
+        }
+    }
+    if (fs::exists(directory, error)) {
+        if (!fs::exists(marker, error) && !fs::is_empty(directory, error)) {
+            throw std::runtime_error("Directory is not empty and does not contain a corpus: " + directory.string());
+        }
+        fs::remove_all(directory);
+    }
+    fs::remove(marker, error);
+    const size_t perDirectory = std::max<size_t>(spec.filesPerDirectory, 1);
+    const size_t perGroup = std::max<size_t>(spec.directoriesPerGroup, 1);
+    for (size_t i = 0; i < plan.size(); ++i) {
+        size_t directoryIndex = i / perDirectory;
+        fs::path parent = directory / ("g" + std::to_string(directoryIndex / perGroup)) / ("d" + std::to_string(directoryIndex));
+        if (i % perDirectory == 0) {
+            fs::create_directories(parent);
+        }
+        writeFile(parent / ("f" + std::to_string(i) + extensions[plan[i].extension]), plan[i]);
+    }
+    std::ofstream out(marker, std::ios::trunc);
+    out << description << '\n';
+    return info;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// Параметры синтетического набора файлов; одинаковые параметры всегда дают одинаковый набор
+struct CorpusSpec {
+    size_t fileCount = 20000; // количество файлов
+    size_t filesPerDirectory = 64; // файлов в одной директории
+    size_t directoriesPerGroup = 32; // директорий в одной директории верхнего уровня
+    uint64_t minSize = 1; // минимальный размер файла
+    uint64_t maxSize = 256 * 1024; // максимальный размер файла (размеры распределены логарифмически равномерно)
+    double duplicateRatio = 0.2; // доля файлов - точных копий более ранних файлов
+    double sharedPrefixRatio = 0.1; // доля файлов того же размера и содержимого, что и более ранний файл, кроме одного байта в последней четверти
+    uint64_t seed = 7; // начальное значение генератора
+};
+
+// Сведения о созданном наборе
+struct CorpusInfo {
+    size_t files = 0; // количество файлов
+    size_t duplicates = 0; // количество точных копий
+    size_t sharedPrefix = 0; // количество файлов с общим началом
+    uint64_t bytes = 0; // общий размер файлов
+};
+
+// Функция для создания набора файлов в директории root. Если в root уже лежит набор с теми же параметрами,
+// он используется повторно; непустая директория без описания набора не изменяется (выбрасывается исключение)
+CorpusInfo generateCorpus(const std::filesystem::path& root, const CorpusSpec& spec);
@@ -0,0 +1,45 @@
+#include <iostream>
+#include <boost/program_options.hpp>
+#include "corpus_generator.h"
+
+namespace fs = std::filesystem;
+namespace po = boost::program_options;
+
+// Генератор синтетического набора файлов для замеров lab07 на одинаковых данных
+int main(int argc, char* argv[]) {
+    CorpusSpec spec;
+    fs::path root;
+    po::options_description options("Usage: lab07_corpus [options] directory\nOptions");
+    options.add_options()
+        ("help,h", "show this help message")
+        ("directory", po::value<fs::path>(&root), "directory to create the corpus in")
+        ("files,n", po::value<size_t>(&spec.fileCount)->default_value(spec.fileCount), "number of files")
+        ("per-directory", po::value<size_t>(&spec.filesPerDirectory)->default_value(spec.filesPerDirectory), "files per directory")
+        ("min-size", po::value<uint64_t>(&spec.minSize)->default_value(spec.minSize), "minimum file size in bytes")
+        ("max-size", po::value<uint64_t>(&spec.maxSize)->default_value(spec.maxSize), "maximum file size in bytes (sizes are log-uniform)")
+        ("duplicates", po::value<double>(&spec.duplicateRatio)->default_value(spec.duplicateRatio), "fraction of exact copies")
+        ("shared-prefix", po::value<double>(&spec.sharedPrefixRatio)->default_value(spec.sharedPrefixRatio), "fraction of copies differing in one byte near the end")
+        ("seed", po::value<uint64_t>(&spec.seed)->default_value(spec.seed), "random seed");
+    po::positional_options_description positional;
+    positional.add("directory", 1);
+    po::variables_map variables;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(options).positional(positional).run(), variables);
+        po::notify(variables);
+    } catch (const po::error& error) {
+        std::cerr << error.what() << std::endl << options << std::endl;
+        return 1;
+    }
+    if (variables.count("help") || root.empty()) {
+        std::cout << options << std::endl;
+        return root.empty() && !variables.count("help") ? 1 : 0;
+    }
+    try {
+        CorpusInfo info = generateCorpus(root, spec);
+        std::cout << info.files << " files, " << info.duplicates << " duplicates, " << info.sharedPrefix << " shared-prefix, " << info.bytes << " bytes" << std::endl;
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "corpus_generator.h"
+#include "block_hash.h"
+#include "block_layout.h"
+#include "directory_walker.h"
+#include "duplicate_finder.h"
+#include "file_reader.h"
+#include "file_table.h"
+#include "glob_matcher.h"
+#include "hash_sequence.h"
+#include "result_sink.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::atomic<size_t> heapAllocations{0}; // выделения памяти в куче за время работы замеров
+
+} // namespace
+
+// Подсчет выделений памяти: замеры горячего пути сообщают количество выделений на файл
+void* operator new(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size != 0 ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* memory = nullptr;
+    if (::posix_memalign(&memory, std::max(static_cast<size_t>(alignment), sizeof(void*)), size != 0 ? size : 1) != 0) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+// GCC считает память operator new несовместимой с free, не видя, что он заменен выделением через malloc (-Wmismatched-new-delete)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas" // предупреждения нет до GCC 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+// Набор файлов, общий для всех замеров: создается при первом обращении (каталог задается переменной LAB07_BENCH_CORPUS)
+struct Corpus {
+    fs::path root;
+    CorpusInfo info;
+    std::vector<fs::path> paths; // пути всех файлов
+    std::vector<FileMetadata> metadata; // метаданные всех файлов
+};
+
+const Corpus& corpus() {
+    static const Corpus instance = [] {
+        Corpus result;
+        const char* directory = std::getenv("LAB07_BENCH_CORPUS");
+        result.root = directory != nullptr ? fs::path(directory) : fs::temp_directory_path() / "lab07-bench-corpus";
+        result.info = generateCorpus(result.root, CorpusSpec());
+        std::mutex mutex;
+        DirectoryWalker(1).walk({result.root}, -1, [](size_t, const fs::path&) { return false; }, [](NativeName) { return true; },
+            [&](size_t, size_t, fs::path path, const FileMetadata& metadata) {
+                std::lock_guard<std::mutex> lock(mutex);
+                result.paths.push_back(std::move(path));
+                result.metadata.push_back(metadata);
+            });
+        return result;
+    }();
+    return instance;
+}
+
+// Поток вывода, отбрасывающий данные
+class NullBuffer : public std::streambuf {
+protected:
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+    int overflow(int c) override { return c; }
+};
+
+// Обход директорий: readdir и statx, потоков - аргумент замера
+void walkStage(benchmark::State& state) {
+    const Corpus& data = corpus();
+    DirectoryWalker walker(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        std::vector<size_t> counts(walker.threadCount(), 0);
+        walker.walk({data.root}, -1, [](size_t, const fs::path&) { return false; }, [](NativeName) { return true; },
+            [&counts](size_t worker, size_t, fs::path, const FileMetadata&) { ++counts[worker]; });
+        benchmark::DoNotOptimize(counts.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * data.paths.size()));
+}
+BENCHMARK(walkStage)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Фильтр имен по маскам
+void filterStage(benchmark::State& state) {
+    const Corpus& data = corpus();
+    std::vector<std::string> names;
+    for (const auto& path : data.paths) {
+        names.push_back(path.filename().string());
+    }
+    GlobFilter filter({"*.txt", "*.JPG", "f1?[0-5]*"}, {"*7.log"}, false);
+    for (auto _ : state) {
+        size_t accepted = 0;
+        for (const auto& name : names) {
+            accepted += filter.matches(name) ? 1 : 0;
+        }
+        benchmark::DoNotOptimize(accepted);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * names.size()));
+}
+BENCHMARK(filterStage);
+
+// Хэш-функция блоков в памяти: алгоритм, размер блока и реализация (0 - общая, 1 - выбранная forSize) - аргументы замера
+void blockHashStage(benchmark::State& state) {
+    const BlockHasher& hasher = selectBlockHasher(static_cast<HashAlgorithm>(state.range(0)));
+    std::vector<unsigned char> block(static_cast<size_t>(state.range(1)));
+    std::mt19937 random(1);
+    std::generate(block.begin(), block.end(), [&random] { return static_cast<unsigned char>(random()); });
+    const BlockHashFunction hash = state.range(2) != 0 ? hasher.forSize(block.size()) : hasher.hash;
+    const bool specialized = hash != hasher.hash;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(hash(block.data(), block.size()));
+    }
+    state.SetLabel(std::string(hasher.name) + (specialized ? " fixed" : ""));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * block.size()));
+}
+BENCHMARK(blockHashStage)->ArgsProduct({{static_cast<int64_t>(HashAlgorithm::CRC32), static_cast<int64_t>(HashAlgorithm::CRC32C), static_cast<int64_t>(HashAlgorithm::XXH64)}, {4096, 1 << 16, 1 << 20}, {0, 1}});
+
+// Чтение и хэширование всех файлов набора целиком (из кэша страниц): фиксированные или адаптивные блоки
+void readStage(benchmark::State& state) {
+    const Corpus& data = corpus();
+    const BlockHasher& hasher = selectBlockHasher(HashAlgorithm::CRC32);
+    const BlockLayout layout(static_cast<BlockStrategy>(state.range(0)), 4096);
+    for (auto _ : state) {
+        size_t hashes = 0;
+        for (size_t i = 0; i < data.paths.size(); ++i) {
+            if (layout.strategy() == BlockStrategy::Fixed) {
+                hashes += readFile(data.paths[i], static_cast<size_t>(layout.blockSize()), hasher).size();
+            } else {
+                std::vector<FileRange> ranges;
+                for (uint64_t block = 0; block < layout.blockCount(data.metadata[i].size); ++block) {
+                    ranges.push_back(layout.block(data.metadata[i].size, block));
+                }
+                hashes += readFileRanges(data.paths[i], ranges, hasher).size();
+            }
+        }
+        benchmark::DoNotOptimize(hashes);
+    }
+    state.SetLabel(blockStrategyName(layout.strategy()));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.info.bytes));
+}
+BENCHMARK(readStage)->Arg(static_cast<int64_t>(BlockStrategy::Fixed))->Arg(static_cast<int64_t>(BlockStrategy::Adaptive))->Unit(benchmark::kMillisecond);
+
+// Хэширование первых блоков всех файлов через ленивые последовательности, как на первом проходе поиска, и выделения памяти на файл
+void firstBlockStage(benchmark::State& state) {
+    const Corpus& data = corpus();
+    const BlockLayout layout(static_cast<BlockStrategy>(state.range(0)), 4096);
+    FileTable table;
+    for (size_t i = 0; i < data.paths.size(); ++i) {
+        table.add(data.paths[i], data.metadata[i]);
+    }
+    const HashingContext context{table, layout, selectBlockHasher(HashAlgorithm::CRC32)};
+    size_t allocations = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::vector<LazyHashSequence> files;
+        files.reserve(table.size());
+        for (size_t i = 0; i < table.size(); ++i) {
+            files.emplace_back(context, static_cast<uint32_t>(i));
+        }
+        state.ResumeTiming();
+        const size_t before = heapAllocations.load(std::memory_order_relaxed);
+        for (auto& file : files) {
+            if (file.blockCount() > 0) {
+                benchmark::DoNotOptimize(file.hashAt(0));
+            }
+        }
+        allocations += heapAllocations.load(std::memory_order_relaxed) - before;
+    }
+    state.counters["allocs/file"] = static_cast<double>(allocations) / static_cast<double>(state.iterations() * table.size());
+    state.SetLabel(blockStrategyName(layout.strategy()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * table.size()));
+}
+BENCHMARK(firstBlockStage)->Arg(static_cast<int64_t>(BlockStrategy::Fixed))->Arg(static_cast<int64_t>(BlockStrategy::Adaptive))->Unit(benchmark::kMillisecond);
+
+// Группировка: таблица кандидатов, сортировка по размеру и уточнение групп одного размера по хэшам блоков
+void groupStage(benchmark::State& state) {
+    const Corpus& data = corpus();
+    const BlockHasher& hasher = selectBlockHasher(HashAlgorithm::CRC32);
+    const BlockLayout layout(static_cast<BlockStrategy>(state.range(0)), 4096);
+    for (auto _ : state) {
+        FileTable table;
+        for (size_t i = 0; i < data.paths.size(); ++i) {
+            table.add(data.paths[i], data.metadata[i]);
+        }
+        std::vector<uint32_t> order(table.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = static_cast<uint32_t>(i);
+        }
+        std::sort(order.begin(), order.end(), [&table](uint32_t left, uint32_t right) { return table.fileSize(left) < table.fileSize(right); });
+        const HashingContext context{table, layout, hasher};
+        std::vector<LazyHashSequence> files;
+        for (uint32_t file : order) {
+            files.emplace_back(context, file);
+        }
+        size_t groups = 0;
+        for (size_t begin = 0, end = 0; begin < files.size(); begin = end) {
+            while (end < files.size() && files[end].fileSize() == files[begin].fileSize()) {
+                ++end;
+            }
+            if (end - begin < 2) {
+                continue;
+            }
+            std::vector<LazyHashSequence*> group;
+            for (size_t i = begin; i < end; ++i) {
+                group.push_back(&files[i]);
+            }
+            std::vector<std::vector<LazyHashSequence*>> duplicates;
+            refineGroup(std::move(group), duplicates);
+            groups += duplicates.size();
+        }
+        state.counters["groups"] = static_cast<double>(groups);
+    }
+    state.SetLabel(blockStrategyName(layout.strategy()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * data.paths.size()));
+}
+BENCHMARK(groupStage)->Arg(static_cast<int64_t>(BlockStrategy::Fixed))->Arg(static_cast<int64_t>(BlockStrategy::Adaptive))->Unit(benchmark::kMillisecond);
+
+// Форматирование и буферизованный вывод групп: формат - аргумент замера
+void outputStage(benchmark::State& state) {
+    const Corpus& data = corpus();
+    static const char* formats[] = {"text", "jsonl", "nul"};
+    std::map<uint64_t, DuplicateGroup> bySize; // группы из файлов одного размера, как их выводит поиск
+    for (size_t i = 0; i < data.paths.size(); ++i) {
+        DuplicateGroup& group = bySize[data.metadata[i].size];
+        group.fileSize = data.metadata[i].size;
+        group.files.push_back(data.paths[i]);
+    }
+    std::vector<DuplicateGroup> groups;
+    for (auto& item : bySize) {
+        if (item.second.files.size() > 1) {
+            std::sort(item.second.files.begin(), item.second.files.end());
+            groups.push_back(std::move(item.second));
+        }
+    }
+    NullBuffer buffer;
+    std::ostream out(&buffer);
+    size_t paths = 0;
+    for (auto _ : state) {
+        std::unique_ptr<ResultSink> sink = createResultSink(formats[state.range(0)], out);
+        for (const auto& group : groups) {
+            sink->write(group);
+            paths += group.files.size();
+        }
+        sink->finish();
+    }
+    state.SetLabel(formats[state.range(0)]);
+    state.SetItemsProcessed(static_cast<int64_t>(paths));
+}
+BENCHMARK(outputStage)->DenseRange(0, 2);
+
+// Поиск целиком через DuplicateFinder (без кэша и io_uring): потоков - аргумент замера
+void finderRun(benchmark::State& state) {
+    const Corpus& data = corpus();
+    FinderConfig config;
+    config.directories = {data.root};
+    config.threadCount = static_cast<size_t>(state.range(0));
+    config.asyncIo = false;
+    for (auto _ : state) {
+        DuplicateFinder finder(config);
+        size_t groups = 0;
+        finder.run([&groups](const DuplicateGroup&) { ++groups; });
+        state.counters["groups"] = static_cast<double>(groups);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * data.paths.size()));
+}
+BENCHMARK(finderRun)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
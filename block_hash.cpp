@@ -0,0 +1,504 @@
+#include "block_hash.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LAB07_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define LAB07_ARM64 1
+#include <arm_acle.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+// Атрибут для компиляции отдельной функции с расширенным набором инструкций (MSVC разрешает интринсики без него)
+#if defined(_MSC_VER) && !defined(__clang__)
+#define LAB07_TARGET(features)
+#else
+#define LAB07_TARGET(features) __attribute__((target(features)))
+#endif
+
+// Обязательная подстановка: у ядер, вызванных из специализации для фиксированного размера, длина становится константой
+#if defined(_MSC_VER) && !defined(__clang__)
+#define LAB07_ALWAYS_INLINE __forceinline
+#else
+#define LAB07_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace {
+
+// Таблицы для табличного вычисления CRC по 8 байтов за шаг (slicing-by-8) для отраженного полинома
+struct CrcTables {
+    explicit CrcTables(uint32_t reflectedPolynomial) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? reflectedPolynomial : 0);
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (size_t slice = 1; slice < 8; ++slice) {
+                table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xFF];
+            }
+        }
+    }
+
+    // Обновление состояния CRC (состояние хранится без финальной инверсии)
+    LAB07_ALWAYS_INLINE uint32_t update(uint32_t crc, const unsigned char* data, size_t size) const {
+        while (size >= 8) {
+            uint32_t low;
+            uint32_t high;
+            std::memcpy(&low, data, 4);
+            std::memcpy(&high, data + 4, 4);
+            low ^= crc;
+            crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+                  table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^ table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+            data += 8;
+            size -= 8;
+        }
+        while (size-- > 0) {
+            crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xFF];
+        }
+        return crc;
+    }
+
+    std::array<std::array<uint32_t, 256>, 8> table;
+};
+
+const CrcTables& crc32Tables() {
+    static const CrcTables tables(0xEDB88320u);
+    return tables;
+}
+
+const CrcTables& crc32cTables() {
+    static const CrcTables tables(0x82F63B78u);
+    return tables;
+}
+
+// Произведение многочленов a и b по модулю отраженного полинома CRC (бит 31 - коэффициент при x^0)
+constexpr uint32_t multiplyModulo(uint32_t a, uint32_t b, uint32_t reflectedPolynomial) {
+    uint32_t product = 0;
+    for (uint32_t mask = 0x80000000u; mask != 0; mask >>= 1) {
+        product ^= (a & mask) ? b : 0;
+        b = (b >> 1) ^ ((b & 1) ? reflectedPolynomial : 0);
+    }
+    return product;
+}
+
+// x^(8*bytes) по модулю полинома: умножение на него сдвигает состояние CRC на bytes нулевых байтов
+constexpr uint32_t crcShiftFactor(size_t bytes, uint32_t reflectedPolynomial) {
+    uint32_t factor = 0x80000000u; // x^0
+    uint32_t power = 0x00800000u; // x^8, затем x^16, x^32, ...
+    for (; bytes != 0; bytes >>= 1) {
+        if (bytes & 1) {
+            factor = multiplyModulo(factor, power, reflectedPolynomial);
+        }
+        power = multiplyModulo(power, power, reflectedPolynomial);
+    }
+    return factor;
+}
+
+// Переносимые CRC блока фиксированного размера: цикл по 8 байтов без хвоста
+template <size_t Size>
+uint32_t crc32PortableFixed(const unsigned char* data, size_t) {
+    return ~crc32Tables().update(0xFFFFFFFFu, data, Size);
+}
+
+template <size_t Size>
+uint32_t crc32cPortableFixed(const unsigned char* data, size_t) {
+    return ~crc32cTables().update(0xFFFFFFFFu, data, Size);
+}
+
+uint32_t crc32cPortable(const unsigned char* data, size_t size) {
+    return ~crc32cTables().update(0xFFFFFFFFu, data, size);
+}
+
+#if LAB07_X86
+// CRC32 свертками с умножением без переносов (Intel, "Fast CRC Computation Using PCLMULQDQ Instruction");
+// size >= 64 и кратен 16, состояние передается и возвращается без финальной инверсии
+LAB07_TARGET("sse4.1,pclmul") LAB07_ALWAYS_INLINE
+uint32_t crc32FoldPclmul(const unsigned char* data, size_t size, uint32_t crc) {
+    alignas(16) static const uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+    alignas(16) static const uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+    alignas(16) static const uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+    alignas(16) static const uint64_t poly[] = {0x01db710641, 0x01f7011641};
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+    x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00));
+    x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10));
+    x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20));
+    x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+    data += 64;
+    size -= 64;
+    // Параллельная свертка четырех 128-битных потоков
+    while (size >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00));
+        y6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10));
+        y7 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20));
+        y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        data += 64;
+        size -= 64;
+    }
+    // Свертка четырех потоков в один
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+    // Оставшиеся 16-байтовые блоки
+    while (size >= 16) {
+        x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        data += 16;
+        size -= 16;
+    }
+    // Свертка 128 битов в 64
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    // Редукция Барретта до 32 битов
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+LAB07_TARGET("sse4.1,pclmul")
+uint32_t crc32Pclmul(const unsigned char* data, size_t size) {
+    uint32_t crc = 0xFFFFFFFFu;
+    if (size >= 64) {
+        size_t folded = size & ~static_cast<size_t>(15);
+        crc = crc32FoldPclmul(data, folded, crc);
+        data += folded;
+        size -= folded;
+    }
+    return ~crc32Tables().update(crc, data, size);
+}
+
+// Размер кратен 64: весь блок сворачивается без остатка, количество итераций свертки известно при компиляции
+template <size_t Size>
+LAB07_TARGET("sse4.1,pclmul")
+uint32_t crc32PclmulFixed(const unsigned char* data, size_t) {
+    static_assert(Size >= 64 && Size % 64 == 0, "block size must be a multiple of 64");
+    return ~crc32FoldPclmul(data, Size, 0xFFFFFFFFu);
+}
+
+LAB07_TARGET("sse4.2")
+uint32_t crc32cSse42(const unsigned char* data, size_t size) {
+#if defined(__x86_64__) || defined(_M_X64)
+    uint64_t crc = 0xFFFFFFFFu;
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        crc = _mm_crc32_u64(crc, word);
+        data += 8;
+        size -= 8;
+    }
+    uint32_t crc32 = static_cast<uint32_t>(crc);
+#else
+    uint32_t crc32 = 0xFFFFFFFFu;
+#endif
+    while (size-- > 0) {
+        crc32 = _mm_crc32_u8(crc32, *data++);
+    }
+    return ~crc32;
+}
+
+// Инструкция crc32 выполняется 3 такта, но новая может начинаться каждый такт: в общем цикле каждая ждет предыдущую.
+// При известном размере блок делится на три равные полосы, которые считаются одновременно, а их состояния склеиваются
+// умножением на заранее вычисленные сдвиги x^(8*длина полосы) по модулю полинома
+template <size_t Size>
+LAB07_TARGET("sse4.2")
+uint32_t crc32cSse42Fixed(const unsigned char* data, size_t) {
+    static_assert(Size % 8 == 0, "block size must be a multiple of 8");
+#if defined(__x86_64__) || defined(_M_X64)
+    constexpr uint32_t polynomial = 0x82F63B78u;
+    constexpr size_t lane = Size / 24 * 8; // байтов в полосе, кратно 8
+    constexpr uint32_t shiftOne = crcShiftFactor(lane, polynomial);
+    constexpr uint32_t shiftTwo = crcShiftFactor(2 * lane, polynomial);
+    uint64_t crc0 = 0xFFFFFFFFu;
+    uint64_t crc1 = 0; // состояния второй и третьей полосы без начального значения: оно учтено в сдвиге первой
+    uint64_t crc2 = 0;
+    for (size_t offset = 0; offset < lane; offset += 8) {
+        uint64_t word0, word1, word2;
+        std::memcpy(&word0, data + offset, 8);
+        std::memcpy(&word1, data + lane + offset, 8);
+        std::memcpy(&word2, data + 2 * lane + offset, 8);
+        crc0 = _mm_crc32_u64(crc0, word0);
+        crc1 = _mm_crc32_u64(crc1, word1);
+        crc2 = _mm_crc32_u64(crc2, word2);
+    }
+    uint64_t crc = multiplyModulo(shiftTwo, static_cast<uint32_t>(crc0), polynomial) ^ multiplyModulo(shiftOne, static_cast<uint32_t>(crc1), polynomial) ^ crc2;
+    for (size_t offset = 3 * lane; offset < Size; offset += 8) { // остаток, не кратный трем словам
+        uint64_t word;
+        std::memcpy(&word, data + offset, 8);
+        crc = _mm_crc32_u64(crc, word);
+    }
+    return ~static_cast<uint32_t>(crc);
+#else
+    return crc32cSse42(data, Size);
+#endif
+}
+
+// Проверка бита регистра ECX функции CPUID 1
+bool cpuidFeature(int ecxBit) {
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 1);
+    unsigned int ecx = static_cast<unsigned int>(info[2]);
+#else
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+#endif
+    return (ecx >> ecxBit) & 1;
+}
+
+bool cpuHasPclmul() { return cpuidFeature(1) && cpuidFeature(19); } // PCLMULQDQ и SSE4.1 (_mm_extract_epi32)
+bool cpuHasSse42() { return cpuidFeature(20); }
+#endif
+
+#if LAB07_ARM64
+#if defined(__clang__)
+#define LAB07_ARM_CRC LAB07_TARGET("crc")
+#else
+#define LAB07_ARM_CRC LAB07_TARGET("+crc")
+#endif
+
+LAB07_ARM_CRC
+uint32_t crc32Armv8(const unsigned char* data, size_t size) {
+    uint32_t crc = 0xFFFFFFFFu;
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        crc = __crc32d(crc, word);
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = __crc32b(crc, *data++);
+    }
+    return ~crc;
+}
+
+LAB07_ARM_CRC
+uint32_t crc32cArmv8(const unsigned char* data, size_t size) {
+    uint32_t crc = 0xFFFFFFFFu;
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        crc = __crc32cd(crc, word);
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = __crc32cb(crc, *data++);
+    }
+    return ~crc;
+}
+
+bool cpuHasArmCrc() {
+#if defined(__APPLE__) || defined(__ARM_FEATURE_CRC32)
+    return true; // все процессоры Apple Silicon поддерживают CRC32
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return false;
+#endif
+}
+#endif
+
+// xxHash64 (https://github.com/Cyan4973/xxHash), результат сворачивается до 32 битов
+constexpr uint64_t xxhPrime1 = 11400714785074694791ULL;
+constexpr uint64_t xxhPrime2 = 14029467366897019727ULL;
+constexpr uint64_t xxhPrime3 = 1609587929392839161ULL;
+constexpr uint64_t xxhPrime4 = 9650029242287828579ULL;
+constexpr uint64_t xxhPrime5 = 2870177450012600261ULL;
+
+inline uint64_t rotateLeft(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+inline uint64_t read64(const unsigned char* data) {
+    uint64_t value;
+    std::memcpy(&value, data, 8);
+    return value;
+}
+
+inline uint64_t xxhRound(uint64_t acc, uint64_t input) {
+    acc += input * xxhPrime2;
+    return rotateLeft(acc, 31) * xxhPrime1;
+}
+
+inline uint64_t xxhMergeRound(uint64_t acc, uint64_t value) {
+    acc ^= xxhRound(0, value);
+    return acc * xxhPrime1 + xxhPrime4;
+}
+
+LAB07_ALWAYS_INLINE uint64_t xxHash64(const unsigned char* data, size_t size, uint64_t seed) {
+    const unsigned char* end = data + size;
+    uint64_t hash;
+    if (size >= 32) {
+        uint64_t v1 = seed + xxhPrime1 + xxhPrime2;
+        uint64_t v2 = seed + xxhPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - xxhPrime1;
+        do {
+            v1 = xxhRound(v1, read64(data));
+            v2 = xxhRound(v2, read64(data + 8));
+            v3 = xxhRound(v3, read64(data + 16));
+            v4 = xxhRound(v4, read64(data + 24));
+            data += 32;
+        } while (end - data >= 32);
+        hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+        hash = xxhMergeRound(hash, v1);
+        hash = xxhMergeRound(hash, v2);
+        hash = xxhMergeRound(hash, v3);
+        hash = xxhMergeRound(hash, v4);
+    } else {
+        hash = seed + xxhPrime5;
+    }
+    hash += static_cast<uint64_t>(size);
+    while (end - data >= 8) {
+        hash ^= xxhRound(0, read64(data));
+        hash = rotateLeft(hash, 27) * xxhPrime1 + xxhPrime4;
+        data += 8;
+    }
+    if (end - data >= 4) {
+        uint32_t word;
+        std::memcpy(&word, data, 4);
+        hash ^= static_cast<uint64_t>(word) * xxhPrime1;
+        hash = rotateLeft(hash, 23) * xxhPrime2 + xxhPrime3;
+        data += 4;
+    }
+    while (data < end) {
+        hash ^= static_cast<uint64_t>(*data++) * xxhPrime5;
+        hash = rotateLeft(hash, 11) * xxhPrime1;
+    }
+    hash ^= hash >> 33;
+    hash *= xxhPrime2;
+    hash ^= hash >> 29;
+    hash *= xxhPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint32_t xxHash64Folded(const unsigned char* data, size_t size) {
+    uint64_t hash = xxHash64(data, size, 0);
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+// Размер кратен 32: хвостовые циклы исчезают, основной цикл имеет постоянное число итераций
+template <size_t Size>
+uint32_t xxHash64FoldedFixed(const unsigned char* data, size_t) {
+    static_assert(Size % 32 == 0, "block size must be a multiple of 32");
+    uint64_t hash = xxHash64(data, Size, 0);
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+// Таблица специализаций ядра kernel для каждого из fixedBlockSizes
+#define LAB07_FIXED_KERNELS(kernel) {kernel<fixedBlockSizes[0]>, kernel<fixedBlockSizes[1]>, kernel<fixedBlockSizes[2]>}
+
+BlockHasher detectBlockHasher(HashAlgorithm algorithm) {
+    switch (algorithm) {
+    case HashAlgorithm::CRC32:
+#if LAB07_X86
+        if (cpuHasPclmul()) return {algorithm, "crc32-pclmul", crc32Pclmul, LAB07_FIXED_KERNELS(crc32PclmulFixed)};
+#elif LAB07_ARM64
+        if (cpuHasArmCrc()) return {algorithm, "crc32-armv8", crc32Armv8};
+#endif
+        return {algorithm, "crc32-slice8", calculateCRC32, LAB07_FIXED_KERNELS(crc32PortableFixed)};
+    case HashAlgorithm::CRC32C:
+#if LAB07_X86
+        if (cpuHasSse42()) return {algorithm, "crc32c-sse42", crc32cSse42, LAB07_FIXED_KERNELS(crc32cSse42Fixed)};
+#elif LAB07_ARM64
+        if (cpuHasArmCrc()) return {algorithm, "crc32c-armv8", crc32cArmv8};
+#endif
+        return {algorithm, "crc32c-slice8", crc32cPortable, LAB07_FIXED_KERNELS(crc32cPortableFixed)};
+    case HashAlgorithm::XXH64:
+        break;
+    }
+    return {HashAlgorithm::XXH64, "xxh64", xxHash64Folded, LAB07_FIXED_KERNELS(xxHash64FoldedFixed)};
+}
+
+} // namespace
+
+uint32_t calculateCRC32(const unsigned char* data, size_t size) {
+    return ~crc32Tables().update(0xFFFFFFFFu, data, size);
+}
+
+uint64_t calculateXXH64(const unsigned char* data, size_t size, uint64_t seed) {
+    return xxHash64(data, size, seed);
+}
+
+const BlockHasher& selectBlockHasher(HashAlgorithm algorithm) {
+    static const BlockHasher crc32 = detectBlockHasher(HashAlgorithm::CRC32);
+    static const BlockHasher crc32c = detectBlockHasher(HashAlgorithm::CRC32C);
+    static const BlockHasher xxh64 = detectBlockHasher(HashAlgorithm::XXH64);
+    switch (algorithm) {
+    case HashAlgorithm::CRC32: return crc32;
+    case HashAlgorithm::CRC32C: return crc32c;
+    case HashAlgorithm::XXH64: break;
+    }
+    return xxh64;
+}
+
+bool parseHashAlgorithm(const std::string& name, HashAlgorithm& algorithm) {
+    if (name == "crc32") {
+        algorithm = HashAlgorithm::CRC32;
+    } else if (name == "crc32c") {
+        algorithm = HashAlgorithm::CRC32C;
+    } else if (name == "xxh64") {
+        algorithm = HashAlgorithm::XXH64;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* hashAlgorithmName(HashAlgorithm algorithm) {
+    switch (algorithm) {
+    case HashAlgorithm::CRC32: return "crc32";
+    case HashAlgorithm::CRC32C: return "crc32c";
+    case HashAlgorithm::XXH64: break;
+    }
+    return "xxh64";
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Алгоритм хэширования блоков файла
+enum class HashAlgorithm {
+    CRC32, // CRC32 (полином 0x04C11DB7, как в zip/boost::crc_32_type)
+    CRC32C, // CRC32C (полином Кастаньоли 0x1EDC6F41)
+    XXH64 // xxHash64, свернутый до 32 битов
+};
+
+// Хэш-функция блока
+using BlockHashFunction = uint32_t (*)(const unsigned char* data, size_t size);
+
+// Размеры блоков, для которых реализации скомпилированы отдельно с длиной-константой (циклы без остатка, развернутые и чередующиеся)
+constexpr std::array<size_t, 3> fixedBlockSizes = {4 * 1024, 64 * 1024, 1024 * 1024};
+
+// Реализация хэш-функции блоков, выбранная под возможности процессора
+struct BlockHasher {
+    HashAlgorithm algorithm; // вычисляемый алгоритм
+    const char* name; // название реализации (например, "crc32-pclmul")
+    BlockHashFunction hash; // хэш блока любого размера
+    std::array<BlockHashFunction, fixedBlockSizes.size()> fixed{}; // хэши блоков размеров fixedBlockSizes (nullptr - только hash); аргумент size они не используют
+
+    // Функция для выбора хэш-функции блоков размера size: специализированной, если она есть, иначе общей.
+    // Выбирается один раз перед циклом по блокам одного размера; результат совпадает с hash
+    BlockHashFunction forSize(size_t size) const {
+        for (size_t i = 0; i < fixedBlockSizes.size(); ++i) {
+            if (size == fixedBlockSizes[i] && fixed[i] != nullptr) {
+                return fixed[i];
+            }
+        }
+        return hash;
+    }
+};
+
+// Функция для выбора самой быстрой реализации алгоритма, доступной на текущем процессоре (определяется через CPUID/HWCAP один раз)
+const BlockHasher& selectBlockHasher(HashAlgorithm algorithm);
+
+// Функция для разбора названия алгоритма ("crc32", "crc32c", "xxh64"); возвращает false для неизвестного названия
+bool parseHashAlgorithm(const std::string& name, HashAlgorithm& algorithm);
+
+// Функция для получения названия алгоритма
+const char* hashAlgorithmName(HashAlgorithm algorithm);
+
+// Переносимая реализация CRC32, совпадающая с boost::crc_32_type
+uint32_t calculateCRC32(const unsigned char* data, size_t size);
+
+// Полный 64-битный xxHash64 (отпечатки участков переменной длины, где 32 битов мало)
+uint64_t calculateXXH64(const unsigned char* data, size_t size, uint64_t seed = 0);
@@ -0,0 +1,69 @@
+#include "block_layout.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint64_t growthFactor = 16; // во сколько раз каждый следующий блок середины больше предыдущего
+
+} // namespace
+
+uint64_t BlockLayout::blockCount(uint64_t fileSize) const {
+    if (strategy_ == BlockStrategy::Fixed || fileSize <= 2 * blockSize_) { // у маленького файла только начальный и конечный блоки
+        return (fileSize + blockSize_ - 1) / blockSize_;
+    }
+    const uint64_t maxBlock = std::max(maxAdaptiveBlock, blockSize_);
+    uint64_t middle = fileSize - 2 * blockSize_; // середина файла между начальным и конечным блоками
+    uint64_t count = 2;
+    for (uint64_t length = std::min(blockSize_ * growthFactor, maxBlock); middle > 0; length = std::min(length * growthFactor, maxBlock)) {
+        if (length == maxBlock) { // рост закончился, оставшаяся середина делится на равные блоки
+            return count + (middle + maxBlock - 1) / maxBlock;
+        }
+        middle -= std::min(middle, length);
+        ++count;
+    }
+    return count;
+}
+
+FileRange BlockLayout::block(uint64_t fileSize, uint64_t index) const {
+    if (strategy_ == BlockStrategy::Fixed) {
+        return {index * blockSize_, blockSize_};
+    }
+    if (index == 0) { // начальный блок
+        return {0, std::min(fileSize, blockSize_)};
+    }
+    if (fileSize <= 2 * blockSize_) { // конечный блок маленького файла - остаток после начального
+        return {blockSize_, fileSize - blockSize_};
+    }
+    if (index == 1) { // конечный блок
+        return {fileSize - blockSize_, blockSize_};
+    }
+    const uint64_t maxBlock = std::max(maxAdaptiveBlock, blockSize_);
+    const uint64_t middleEnd = fileSize - blockSize_;
+    uint64_t offset = blockSize_;
+    uint64_t length = std::min(blockSize_ * growthFactor, maxBlock);
+    for (uint64_t i = 2; i < index; ++i) {
+        if (length == maxBlock) { // дальше все блоки одного размера
+            offset += (index - i) * maxBlock;
+            break;
+        }
+        offset += length;
+        length = std::min(length * growthFactor, maxBlock);
+    }
+    return {offset, std::min(length, middleEnd - offset)};
+}
+
+bool parseBlockStrategy(const std::string& name, BlockStrategy& strategy) {
+    if (name == "fixed") {
+        strategy = BlockStrategy::Fixed;
+    } else if (name == "adaptive") {
+        strategy = BlockStrategy::Adaptive;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* blockStrategyName(BlockStrategy strategy) {
+    return strategy == BlockStrategy::Fixed ? "fixed" : "adaptive";
+}
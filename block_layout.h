@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Стратегия разбиения файла на хэшируемые блоки
+enum class BlockStrategy {
+    Fixed, // блоки одного размера, неполный последний блок дополняется нулями
+    Adaptive // начальный блок, конечный блок, затем растущие блоки середины файла
+};
+
+// Участок файла, хэш которого образует один элемент последовательности
+struct FileRange {
+    uint64_t offset = 0; // смещение от начала файла
+    uint64_t length = 0; // длина участка
+};
+
+// Разбиение файла на блоки. У файлов одного размера разбиение одинаковое, поэтому их хэши можно сравнивать поблочно.
+// Адаптивная стратегия хэширует сначала начальный блок (blockSize), затем конечный блок того же размера, затем середину
+// блоками, которые растут в 16 раз (4 КиБ -> 64 КиБ -> 1 МиБ -> 16 МиБ) до maxAdaptiveBlock: различающиеся файлы
+// обычно отсеиваются после чтения одного-двух маленьких блоков, а у совпадающих больших файлов мало хэшей
+class BlockLayout {
+public:
+    static constexpr uint64_t maxAdaptiveBlock = 16 * 1024 * 1024; // предельный размер блока середины файла
+
+    BlockLayout(BlockStrategy strategy, uint64_t blockSize) : strategy_(strategy), blockSize_(blockSize) {}
+
+    BlockStrategy strategy() const { return strategy_; }
+    uint64_t blockSize() const { return blockSize_; } // размер блока (для адаптивной стратегии - начального и конечного)
+    // Количество блоков в файле размера fileSize
+    uint64_t blockCount(uint64_t fileSize) const;
+    // Участок файла, соответствующий блоку index (для фиксированной стратегии последний участок может выходить за конец файла)
+    FileRange block(uint64_t fileSize, uint64_t index) const;
+
+private:
+    BlockStrategy strategy_;
+    uint64_t blockSize_;
+};
+
+// Функция для разбора названия стратегии ("fixed", "adaptive"); возвращает false для неизвестного названия
+bool parseBlockStrategy(const std::string& name, BlockStrategy& strategy);
+
+// Функция для получения названия стратегии
+const char* blockStrategyName(BlockStrategy strategy);
@@ -0,0 +1,82 @@
+#include "buffer_pool.h"
+
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr size_t maxPooledBuffers = 16; // свободных буферов в пуле одного потока
+constexpr size_t maxPooledBytes = 16 * 1024 * 1024; // память свободных буферов одного потока; большие буферы освобождаются сразу
+
+// Свободные буферы потока
+class ThreadBufferPool {
+public:
+    ThreadBufferPool() { free_.reserve(maxPooledBuffers); } // возврат буфера в пул не выделяет память
+
+    ~ThreadBufferPool() {
+        for (const auto& buffer : free_) {
+            ::operator delete[](buffer.first, std::align_val_t(PooledBuffer::alignment));
+        }
+    }
+
+    // Наименьший свободный буфер не меньше capacity; nullptr - подходящего нет
+    unsigned char* take(size_t capacity, size_t& taken) {
+        size_t best = free_.size();
+        for (size_t i = 0; i < free_.size(); ++i) {
+            if (free_[i].second >= capacity && (best == free_.size() || free_[i].second < free_[best].second)) {
+                best = i;
+            }
+        }
+        if (best == free_.size()) {
+            return nullptr;
+        }
+        unsigned char* data = free_[best].first;
+        taken = free_[best].second;
+        bytes_ -= taken;
+        free_[best] = free_.back();
+        free_.pop_back();
+        return data;
+    }
+
+    // Возврат буфера; false - пул полон, буфер нужно освободить
+    bool put(unsigned char* data, size_t capacity) {
+        if (free_.size() == maxPooledBuffers || bytes_ + capacity > maxPooledBytes) {
+            return false;
+        }
+        free_.emplace_back(data, capacity);
+        bytes_ += capacity;
+        return true;
+    }
+
+private:
+    std::vector<std::pair<unsigned char*, size_t>> free_; // начало и размер свободных буферов
+    size_t bytes_ = 0; // память свободных буферов
+};
+
+ThreadBufferPool& threadPool() {
+    thread_local ThreadBufferPool pool;
+    return pool;
+}
+
+} // namespace
+
+PooledBuffer::PooledBuffer(size_t size) : data_(nullptr), capacity_(alignment) {
+    while (capacity_ < size && capacity_ <= SIZE_MAX / 2) {
+        capacity_ *= 2;
+    }
+    if (capacity_ < size) { // больше половины адресного пространства: выделение все равно не удастся
+        throw std::bad_alloc();
+    }
+    data_ = threadPool().take(capacity_, capacity_);
+    if (data_ == nullptr) {
+        data_ = static_cast<unsigned char*>(::operator new[](capacity_, std::align_val_t(alignment)));
+    }
+}
+
+PooledBuffer::~PooledBuffer() {
+    if (data_ != nullptr && !threadPool().put(data_, capacity_)) {
+        ::operator delete[](data_, std::align_val_t(alignment));
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+// Выровненный по странице буфер из пула потока: при уничтожении память возвращается в пул потока, где буфер был уничтожен,
+// и следующие чтения того же потока берут ее оттуда, так что чтение файлов не выделяет память в куче после первых файлов.
+// Размер буфера округляется до степени двойки (не меньше страницы); пул хранит ограниченное количество свободных буферов
+class PooledBuffer {
+public:
+    // Буфер не меньше size байтов (содержимое не определено)
+    explicit PooledBuffer(size_t size);
+    PooledBuffer(PooledBuffer&& other) noexcept : data_(other.data_), capacity_(other.capacity_) {
+        other.data_ = nullptr;
+        other.capacity_ = 0;
+    }
+    PooledBuffer& operator=(PooledBuffer&&) = delete;
+    ~PooledBuffer();
+
+    unsigned char* data() const { return data_; }
+    size_t capacity() const { return capacity_; } // доступный размер (не меньше запрошенного)
+
+    static constexpr size_t alignment = 4096; // выравнивание начала и размера (подходит и для O_DIRECT)
+
+private:
+    unsigned char* data_;
+    size_t capacity_;
+};
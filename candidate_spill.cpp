@@ -0,0 +1,214 @@
+#include "candidate_spill.h"
+
+#include <algorithm>
+#include <fstream>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <tuple>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using NativeString = fs::path::string_type;
+using RecordKey = std::tuple<uint64_t, uint64_t, uint64_t>; // размер, устройство, inode
+
+// Кандидат в серии
+struct SpillRecord {
+    FileMetadata metadata;
+    NativeString path;
+};
+
+RecordKey recordKey(const FileMetadata& metadata) {
+    return RecordKey(metadata.size, metadata.device, metadata.inode);
+}
+
+// Функция для записи кандидата в серию (формат временный: файлы читает только тот же процесс)
+void writeRecord(std::ostream& out, const FileMetadata& metadata, const NativeString& path) {
+    const uint64_t length = path.size();
+    out.write(reinterpret_cast<const char*>(&metadata), sizeof(metadata));
+    out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.write(reinterpret_cast<const char*>(path.data()), static_cast<std::streamsize>(length * sizeof(fs::path::value_type)));
+}
+
+// Функция для чтения следующего кандидата серии; false - серия закончилась
+bool readRecord(std::istream& in, const fs::path& runPath, SpillRecord& record) {
+    if (!in.read(reinterpret_cast<char*>(&record.metadata), sizeof(record.metadata))) {
+        if (in.gcount() == 0) {
+            return false;
+        }
+        throw std::runtime_error("Spill file is truncated: " + runPath.string());
+    }
+    uint64_t length = 0;
+    in.read(reinterpret_cast<char*>(&length), sizeof(length));
+    record.path.resize(static_cast<size_t>(length));
+    if (!in || !in.read(reinterpret_cast<char*>(&record.path[0]), static_cast<std::streamsize>(length * sizeof(fs::path::value_type)))) {
+        throw std::runtime_error("Spill file is truncated: " + runPath.string());
+    }
+    return true;
+}
+
+// Функция для завершения записи серии
+void closeRun(std::ofstream& out, const fs::path& runPath) {
+    out.close();
+    if (!out) {
+        throw std::runtime_error("Cannot write spill file: " + runPath.string());
+    }
+}
+
+// Функция для k-путевого слияния серий: кандидаты передаются в onRecord по возрастанию (размер, устройство, inode)
+void mergeRuns(const std::vector<fs::path>& runs, const std::function<void(const SpillRecord& record)>& onRecord) {
+    std::vector<std::ifstream> inputs(runs.size());
+    std::vector<SpillRecord> current(runs.size()); // очередной кандидат каждой серии
+    using HeapItem = std::pair<RecordKey, size_t>;
+    std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem>> heap;
+    for (size_t i = 0; i < runs.size(); ++i) {
+        inputs[i].open(runs[i], std::ios::binary);
+        if (!inputs[i]) {
+            throw std::runtime_error("Cannot read spill file: " + runs[i].string());
+        }
+        if (readRecord(inputs[i], runs[i], current[i])) {
+            heap.emplace(recordKey(current[i].metadata), i);
+        }
+    }
+    while (!heap.empty()) {
+        const size_t run = heap.top().second;
+        heap.pop();
+        onRecord(current[run]);
+        if (readRecord(inputs[run], runs[run], current[run])) {
+            heap.emplace(recordKey(current[run].metadata), run);
+        }
+    }
+}
+
+} // namespace
+
+CandidateSpill::CandidateSpill(fs::path directory) : parent_(std::move(directory)) {}
+
+CandidateSpill::~CandidateSpill() {
+    if (!directory_.empty()) {
+        std::error_code error;
+        fs::remove_all(directory_, error);
+    }
+}
+
+void CandidateSpill::write(const FileTable& table) {
+    if (table.size() == 0) {
+        return;
+    }
+    std::vector<uint32_t> order(table.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    std::sort(order.begin(), order.end(), [&table](uint32_t left, uint32_t right) {
+        return std::make_tuple(table.fileSize(left), table.device(left), table.inode(left)) < std::make_tuple(table.fileSize(right), table.device(right), table.inode(right));
+    });
+    const fs::path runPath = nextRunPath();
+    std::ofstream out(runPath, std::ios::binary | std::ios::trunc);
+    NativeString path;
+    for (uint32_t index : order) {
+        table.nativePath(index, path);
+        writeRecord(out, table.metadata(index), path);
+    }
+    closeRun(out, runPath);
+    std::lock_guard<std::mutex> lock(mutex_);
+    runs_.push_back(runPath);
+    files_ += table.size();
+}
+
+size_t CandidateSpill::runCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return runs_.size();
+}
+
+uint64_t CandidateSpill::fileCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return files_;
+}
+
+void CandidateSpill::forEachBatch(size_t maxBytes, size_t bytesPerFile, const std::function<void(const FileTable& batch)>& onBatch) {
+    std::vector<fs::path> runs;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        runs = runs_;
+    }
+    // Серий больше, чем можно открыть одновременно: промежуточные проходы сливают их в более длинные серии
+    while (runs.size() > maxMergedRuns) {
+        std::vector<fs::path> merged;
+        for (size_t first = 0; first < runs.size(); first += maxMergedRuns) {
+            std::vector<fs::path> part(runs.begin() + first, runs.begin() + std::min(first + maxMergedRuns, runs.size()));
+            if (part.size() == 1) {
+                merged.push_back(part.front());
+                continue;
+            }
+            const fs::path runPath = nextRunPath();
+            std::ofstream out(runPath, std::ios::binary | std::ios::trunc);
+            mergeRuns(part, [&out](const SpillRecord& record) { writeRecord(out, record.metadata, record.path); });
+            closeRun(out, runPath);
+            for (const auto& input : part) {
+                std::error_code error;
+                fs::remove(input, error);
+            }
+            merged.push_back(runPath);
+        }
+        runs = std::move(merged);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        runs_ = runs;
+    }
+    FileTable batch;
+    SpillRecord first; // первый кандидат текущего размера: входит в порцию, только если размер встретится еще раз
+    bool pending = false; // first еще не добавлен в порцию
+    bool started = false; // встречен хотя бы один кандидат
+    auto add = [&batch](const SpillRecord& record) {
+        if (batch.size() >= UINT32_MAX) {
+            throw std::runtime_error("Too many files to compare");
+        }
+        batch.add(fs::path(record.path), record.metadata);
+    };
+    mergeRuns(runs, [&](const SpillRecord& record) {
+        if (!started || record.metadata.size != first.metadata.size) { // новая группа размера
+            if (batch.size() > 0 && batch.memoryUsage() + batch.size() * bytesPerFile >= maxBytes) {
+                onBatch(batch);
+                batch = FileTable();
+            }
+            first = record;
+            pending = true;
+            started = true;
+            return;
+        }
+        if (pending) {
+            add(first);
+            pending = false;
+        }
+        add(record);
+    });
+    if (batch.size() > 0) {
+        onBatch(batch);
+    }
+}
+
+fs::path CandidateSpill::nextRunPath() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (directory_.empty()) {
+        const fs::path parent = parent_.empty() ? fs::temp_directory_path() : parent_;
+        std::random_device random;
+        for (int attempt = 0; directory_.empty(); ++attempt) {
+            std::ostringstream name;
+            name << "lab07-spill-" << std::hex << random() << random();
+            const fs::path candidate = parent / name.str();
+            std::error_code error;
+            if (fs::create_directory(candidate, error)) { // новая директория: чужие файлы с таким именем не перезаписываются
+                fs::permissions(candidate, fs::perms::owner_all, error);
+                directory_ = candidate;
+            } else if (error || attempt >= 16) {
+                throw std::runtime_error("Cannot create spill directory in " + parent.string());
+            }
+        }
+    }
+    return directory_ / ("run" + std::to_string(nextRun_++));
+}
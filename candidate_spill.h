@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "file_table.h"
+
+// Кандидаты, вынесенные во временные файлы при превышении бюджета памяти. Каждая таблица записывается отдельной серией,
+// отсортированной по (размер, устройство, inode); после обхода серии сливаются, и кандидаты возвращаются порциями из целых групп
+// одного размера по возрастанию размера, так что в памяти находятся только кандидаты (и последовательности хэшей) одной порции.
+// Временные файлы лежат в отдельной директории, которая создается при первой записи и удаляется вместе с объектом
+class CandidateSpill {
+public:
+    // directory - где создать директорию временных файлов (пустой путь - временная директория ОС)
+    explicit CandidateSpill(std::filesystem::path directory);
+    ~CandidateSpill();
+    CandidateSpill(const CandidateSpill&) = delete;
+    CandidateSpill& operator=(const CandidateSpill&) = delete;
+
+    // Запись таблицы отсортированной серией (потокобезопасно)
+    void write(const FileTable& table);
+    // Записанные серии и файлы в них
+    size_t runCount() const;
+    uint64_t fileCount() const;
+
+    // Слияние серий и передача кандидатов в onBatch порциями: порция заканчивается перед первой группой размера, после которой оценка памяти
+    // (память таблицы и bytesPerFile на каждый файл) достигла maxBytes. Файлы с размером, который встречается один раз, в порции не входят
+    void forEachBatch(size_t maxBytes, size_t bytesPerFile, const std::function<void(const FileTable& batch)>& onBatch);
+
+private:
+    // Путь новой серии (создает директорию временных файлов при первом вызове)
+    std::filesystem::path nextRunPath();
+
+    static constexpr size_t maxMergedRuns = 64; // серии, которые сливаются за один проход (каждая - открытый файл)
+
+    std::filesystem::path parent_; // где создается директория временных файлов
+    std::filesystem::path directory_; // директория временных файлов (пустой путь - еще не создана)
+    mutable std::mutex mutex_;
+    std::vector<std::filesystem::path> runs_; // серии, еще не слитые
+    size_t nextRun_ = 0; // номер следующей серии
+    uint64_t files_ = 0; // файлы во всех записанных таблицах
+};
@@ -0,0 +1,192 @@
+#include "change_watcher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <unordered_set>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::chrono::milliseconds stopCheckInterval(250); // как часто ожидание проверяет запрос на остановку
+
+#if defined(__linux__)
+// События, после которых содержимое директории или метаданные ее файлов могли измениться
+constexpr uint32_t watchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF |
+                               IN_MOVE_SELF | IN_ONLYDIR;
+#endif
+
+} // namespace
+
+ChangeWatcher::ChangeWatcher(WatchTiming timing) : timing_(timing) {
+#if defined(__linux__)
+    fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0) {
+        std::cerr << "Cannot use inotify: " << std::strerror(errno) << ", directories are checked for changes periodically" << std::endl;
+        warned_ = true;
+    }
+#endif
+}
+
+ChangeWatcher::~ChangeWatcher() {
+#if defined(__linux__)
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+#endif
+}
+
+void ChangeWatcher::watch(const std::vector<fs::path>& directories) {
+    std::unordered_set<NativeString> wanted;
+    for (const auto& directory : directories) {
+        wanted.insert(directory.native());
+    }
+    std::vector<NativeString> removed;
+    for (const auto& item : watched_) {
+        if (!wanted.count(item.first)) {
+            removed.push_back(item.first);
+        }
+    }
+    for (const auto& directory : removed) {
+        unwatch(directory);
+    }
+    for (const auto& directory : wanted) {
+        if (watched_.count(directory)) {
+            continue;
+        }
+        int watch = -1;
+#if defined(__linux__)
+        if (fd_ >= 0) {
+            watch = ::inotify_add_watch(fd_, directory.c_str(), watchMask);
+            if (watch < 0 && errno != ENOENT && !warned_) { // исчезнувшая директория пропадет из набора после повторного поиска
+                std::cerr << "Cannot watch " << fs::path(directory) << " for changes: " << std::strerror(errno)
+                          << ", directories without notifications are checked every " << timing_.pollInterval.count() / 1000 << " s" << std::endl;
+                warned_ = true;
+            }
+        }
+#endif
+        watched_.emplace(directory, watch);
+        if (watch >= 0) {
+            paths_[watch].push_back(directory);
+        }
+        if (started_) {
+            pending_.insert(directory);
+        }
+    }
+    complete_ = std::none_of(watched_.begin(), watched_.end(), [](const auto& item) { return item.second < 0; });
+    started_ = true;
+}
+
+void ChangeWatcher::unwatch(const NativeString& directory) {
+    auto it = watched_.find(directory);
+    if (it == watched_.end()) {
+        return;
+    }
+    int watch = it->second;
+    watched_.erase(it);
+    auto paths = paths_.find(watch);
+    if (paths != paths_.end()) {
+        paths->second.erase(std::remove(paths->second.begin(), paths->second.end(), directory), paths->second.end());
+        if (paths->second.empty()) {
+#if defined(__linux__)
+            ::inotify_rm_watch(fd_, watch); // ошибка, если ядро уже сняло наблюдатель удаленной директории, не важна
+#endif
+            paths_.erase(paths);
+        }
+    }
+}
+
+bool ChangeWatcher::readEvents() {
+    bool received = false;
+#if defined(__linux__)
+    alignas(inotify_event) char buffer[64 * 1024];
+    for (;;) {
+        ssize_t length = ::read(fd_, buffer, sizeof(buffer));
+        if (length <= 0) { // EAGAIN - уведомлений больше нет
+            break;
+        }
+        for (char* position = buffer; position < buffer + length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(position);
+            position += sizeof(inotify_event) + event->len;
+            received = true;
+            if (event->mask & IN_Q_OVERFLOW) { // часть уведомлений потеряна: изменившимися считаются все директории
+                for (const auto& item : watched_) {
+                    pending_.insert(item.first);
+                }
+                continue;
+            }
+            auto paths = paths_.find(event->wd);
+            if (paths == paths_.end()) {
+                continue;
+            }
+            pending_.insert(paths->second.begin(), paths->second.end());
+            if (event->mask & IN_IGNORED) { // ядро сняло наблюдатель (директория удалена): при следующем watch он создается заново, если директория осталась
+                for (const auto& directory : paths->second) {
+                    watched_.erase(directory);
+                }
+                paths_.erase(paths);
+            }
+        }
+    }
+#endif
+    return received;
+}
+
+bool ChangeWatcher::wait(std::vector<fs::path>& changed, const std::atomic<bool>& stopping) {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point now = Clock::now();
+    Clock::time_point firstEvent = now; // изменения, найденные в watch, ждут паузы так же, как уведомления
+    Clock::time_point lastEvent = now;
+    const Clock::time_point pollDeadline = now + timing_.pollInterval;
+    while (!stopping.load(std::memory_order_relaxed)) {
+        now = Clock::now();
+        Clock::time_point deadline = now + stopCheckInterval;
+        if (!pending_.empty()) {
+            Clock::time_point flush = std::min(lastEvent + timing_.quiet, firstEvent + timing_.maxDelay);
+            if (now >= flush) {
+                changed.assign(pending_.begin(), pending_.end());
+                pending_.clear();
+                return true;
+            }
+            deadline = std::min(deadline, flush);
+        } else if (!complete_) {
+            if (now >= pollDeadline) { // директории без уведомлений проверяются по времени изменения
+                changed.clear();
+                return true;
+            }
+            deadline = std::min(deadline, pollDeadline);
+        }
+        auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now) + std::chrono::milliseconds(1);
+        bool hadPending = !pending_.empty();
+#if defined(__linux__)
+        if (fd_ >= 0) {
+            pollfd descriptor{fd_, POLLIN, 0};
+            if (::poll(&descriptor, 1, static_cast<int>(timeout.count())) <= 0) { // тайм-аут или сигнал (EINTR)
+                continue;
+            }
+        } else {
+            std::this_thread::sleep_for(timeout);
+            continue;
+        }
+#else
+        std::this_thread::sleep_for(timeout);
+        continue;
+#endif
+        if (readEvents()) {
+            lastEvent = Clock::now();
+            if (!hadPending) {
+                firstEvent = lastEvent;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Параметры ожидания изменений
+struct WatchTiming {
+    std::chrono::milliseconds quiet{500}; // пауза без новых уведомлений, после которой изменения передаются (запись файла - много уведомлений)
+    std::chrono::milliseconds maxDelay{5000}; // наибольшая задержка от первого уведомления при непрерывных изменениях
+    std::chrono::milliseconds pollInterval{60000}; // период проверки директорий, за которыми нельзя следить через уведомления
+};
+
+// Наблюдение за изменениями в директориях через уведомления файловой системы (на Linux - inotify, по наблюдателю на директорию).
+// Если уведомления недоступны (другие ОС, исчерпан лимит наблюдателей fs.inotify.max_user_watches), изменения
+// обнаруживаются периодической проверкой: wait раз в pollInterval сообщает о необходимости проверить все директории
+class ChangeWatcher {
+public:
+    explicit ChangeWatcher(WatchTiming timing = WatchTiming());
+    ~ChangeWatcher();
+    ChangeWatcher(const ChangeWatcher&) = delete;
+    ChangeWatcher& operator=(const ChangeWatcher&) = delete;
+
+    // Наблюдение за набором директорий: новые директории добавляются, отсутствующие в наборе перестают наблюдаться.
+    // Директории, добавленные после первого вызова, сразу считаются изменившимися: до начала наблюдения изменения в них не отслеживались
+    void watch(const std::vector<std::filesystem::path>& directories);
+    // Все директории наблюдаются через уведомления
+    bool complete() const { return complete_; }
+    size_t watchedCount() const { return watched_.size(); }
+
+    // Ожидание изменений: возвращает true и изменившиеся директории после паузы quiet без новых уведомлений; пустой changed -
+    // пора проверить все директории по времени изменения (только если complete() == false). Возвращает false, когда stopping стал true
+    bool wait(std::vector<std::filesystem::path>& changed, const std::atomic<bool>& stopping);
+
+private:
+    using NativeString = std::filesystem::path::string_type;
+
+    // Чтение накопившихся уведомлений в pending_; false - уведомлений не было
+    bool readEvents();
+    // Снятие наблюдения за директорией
+    void unwatch(const NativeString& directory);
+
+    WatchTiming timing_;
+    int fd_ = -1; // дескриптор inotify (-1 - уведомления недоступны)
+    bool complete_ = false;
+    bool started_ = false; // первый набор директорий уже передан
+    bool warned_ = false; // предупреждение о директориях без наблюдателя уже выведено
+    std::unordered_map<NativeString, int> watched_; // наблюдаемые директории и их наблюдатели (-1 - наблюдатель не создан)
+    std::unordered_map<int, std::vector<NativeString>> paths_; // директории каждого наблюдателя (одна директория может быть доступна по нескольким путям)
+    std::set<NativeString> pending_; // изменившиеся директории, еще не переданные из wait
+};
@@ -0,0 +1,60 @@
+#include "chunk_index.h"
+
+#include <algorithm>
+#include <tuple>
+#include <unordered_map>
+
+void ChunkIndex::add(uint32_t file, std::vector<Chunk> chunks) {
+    uint64_t bytes = 0;
+    for (const auto& chunk : chunks) {
+        bytes += chunk.length;
+    }
+    const uint64_t count = chunks.size();
+    std::sort(chunks.begin(), chunks.end(), [](const Chunk& left, const Chunk& right) { return left.fingerprint < right.fingerprint; });
+    chunks.erase(std::unique(chunks.begin(), chunks.end(), [](const Chunk& left, const Chunk& right) { return left.fingerprint == right.fingerprint; }), chunks.end());
+    std::lock_guard<std::mutex> lock(mutex_);
+    totalBytes_ += bytes;
+    chunks_ += count;
+    for (const auto& chunk : chunks) {
+        references_.push_back({chunk.fingerprint, file, chunk.length});
+    }
+}
+
+void ChunkIndex::finish() {
+    std::sort(references_.begin(), references_.end(), [](const Reference& left, const Reference& right) {
+        return std::tie(left.fingerprint, left.file) < std::tie(right.fingerprint, right.file);
+    });
+}
+
+ChunkSummary ChunkIndex::summary() const {
+    ChunkSummary summary;
+    summary.totalBytes = totalBytes_;
+    summary.chunks = chunks_;
+    for (size_t i = 0; i < references_.size(); ++i) {
+        if (i == 0 || references_[i].fingerprint != references_[i - 1].fingerprint) {
+            summary.uniqueBytes += references_[i].length;
+            ++summary.uniqueChunks;
+        }
+    }
+    return summary;
+}
+
+void ChunkIndex::forEachPair(size_t maxFiles, const std::function<void(uint32_t first, uint32_t second, uint64_t sharedBytes)>& onPair) const {
+    std::unordered_map<uint64_t, uint64_t> shared; // объем общих участков пар файлов (ключ - номера двух файлов)
+    for (size_t first = 0, last = 0; first < references_.size(); first = last) {
+        for (last = first + 1; last < references_.size() && references_[last].fingerprint == references_[first].fingerprint;) {
+            ++last;
+        }
+        if (last - first < 2 || last - first > maxFiles) {
+            continue;
+        }
+        for (size_t i = first; i < last; ++i) {
+            for (size_t j = i + 1; j < last; ++j) {
+                shared[uint64_t(references_[i].file) << 32 | references_[j].file] += references_[first].length;
+            }
+        }
+    }
+    for (const auto& pair : shared) {
+        onPair(static_cast<uint32_t>(pair.first >> 32), static_cast<uint32_t>(pair.first), pair.second);
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "content_chunker.h"
+
+// Оценка дедупликации по участкам
+struct ChunkSummary {
+    uint64_t totalBytes = 0; // объем всех файлов
+    uint64_t uniqueBytes = 0; // объем различных участков (столько заняли бы файлы при хранении каждого участка один раз)
+    uint64_t chunks = 0; // количество участков
+    uint64_t uniqueChunks = 0; // количество различных участков
+};
+
+// Общий индекс участков всех файлов: ссылки (отпечаток, файл) сортируются, так что файлы с одинаковым участком оказываются рядом
+class ChunkIndex {
+public:
+    // Добавление участков файла с номером file (потокобезопасно; повторы участка внутри файла учитываются только в объеме)
+    void add(uint32_t file, std::vector<Chunk> chunks);
+    // Завершение добавления: сортировка ссылок
+    void finish();
+
+    ChunkSummary summary() const;
+    // Перебор пар файлов с общими участками (в произвольном порядке, first < second) и объема общих участков каждой пары.
+    // Участки, встречающиеся больше чем в maxFiles файлах (обычно нули или заголовки форматов), в пары не входят:
+    // число пар для них растет квадратично, а о сходстве файлов они не говорят
+    void forEachPair(size_t maxFiles, const std::function<void(uint32_t first, uint32_t second, uint64_t sharedBytes)>& onPair) const;
+
+private:
+    // Вхождение участка в файл
+    struct Reference {
+        uint64_t fingerprint;
+        uint32_t file;
+        uint32_t length;
+    };
+
+    std::mutex mutex_;
+    std::vector<Reference> references_;
+    uint64_t totalBytes_ = 0;
+    uint64_t chunks_ = 0;
+};
@@ -0,0 +1,159 @@
+#include "content_chunker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "block_hash.h"
+#include "buffer_pool.h"
+#include "file_reader.h"
+#include "resource_governor.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t streamBufferBytes = 4 * 1024 * 1024; // буфер чтения файлов, которые не отображаются в память
+
+// Функция для построения таблицы Gear-хэша: псевдослучайные 64-битные числа из SplitMix64 с фиксированным началом
+std::array<uint64_t, 256> makeGearTable() {
+    std::array<uint64_t, 256> table{};
+    uint64_t state = 0x6c61623037636463ULL; // "lab07cdc"
+    for (auto& value : table) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        value = z ^ (z >> 31);
+    }
+    return table;
+}
+
+const std::array<uint64_t, 256> gearTable = makeGearTable();
+
+// Функция для построения маски из bits битов, разнесенных по старшим 48 битам хэша: старший бит зависит от последних 64 байтов,
+// так что разнесенные биты учитывают больше байтов окна, чем подряд идущие младшие
+uint64_t spreadMask(size_t bits) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < bits; ++i) {
+        mask |= uint64_t(1) << (63 - i * 48 / bits);
+    }
+    return mask;
+}
+
+// Участок отображения, граница и отпечаток которого вычисляются под защитой от SIGBUS
+struct MappedCut {
+    const ContentChunker* chunker;
+    const unsigned char* data;
+    size_t size;
+    Chunk chunk;
+};
+
+void cutMapped(void* context) {
+    MappedCut& cut = *static_cast<MappedCut*>(context);
+    const size_t length = cut.chunker->cut(cut.data, cut.size);
+    cut.chunk = {calculateXXH64(cut.data, length), static_cast<uint32_t>(length)};
+}
+
+// Функция для вычисления двоичного логарифма степени двойки
+size_t log2Exact(size_t value) {
+    size_t bits = 0;
+    while ((size_t(1) << bits) < value) {
+        ++bits;
+    }
+    return bits;
+}
+
+} // namespace
+
+ContentChunker::ContentChunker(ChunkingParams params) : params_(params) {
+    if (params_.averageSize < 64 || (params_.averageSize & (params_.averageSize - 1)) != 0 || params_.minSize > params_.averageSize ||
+        params_.maxSize < params_.averageSize || params_.maxSize > UINT32_MAX) {
+        throw std::runtime_error("Invalid chunk sizes: average " + std::to_string(params_.averageSize) + ", min " + std::to_string(params_.minSize) +
+                                 ", max " + std::to_string(params_.maxSize));
+    }
+    const size_t bits = log2Exact(params_.averageSize);
+    strictMask_ = spreadMask(bits + 2);
+    looseMask_ = spreadMask(bits - 2);
+}
+
+size_t ContentChunker::cut(const unsigned char* data, size_t size) const {
+    if (size <= params_.minSize) {
+        return size;
+    }
+    const size_t normal = std::min(params_.averageSize, size);
+    const size_t limit = std::min(params_.maxSize, size);
+    uint64_t hash = 0;
+    size_t i = params_.minSize; // байты до минимального размера не могут стать границей и не хэшируются
+    for (; i < normal; ++i) {
+        hash = (hash << 1) + gearTable[data[i]];
+        if ((hash & strictMask_) == 0) {
+            return i + 1;
+        }
+    }
+    for (; i < limit; ++i) {
+        hash = (hash << 1) + gearTable[data[i]];
+        if ((hash & looseMask_) == 0) {
+            return i + 1;
+        }
+    }
+    return limit;
+}
+
+size_t ContentChunker::chunkData(const unsigned char* data, size_t size, bool last, std::vector<Chunk>& chunks, const fs::path* mappedPath) const {
+    size_t offset = 0;
+    while (offset < size && (last || size - offset >= params_.maxSize)) { // без конца файла участок режется, только если впереди maxSize байтов
+        if (mappedPath != nullptr) { // страницы за концом файла, укороченного после отображения, дают SIGBUS
+            MappedCut mapped{this, data + offset, size - offset, {}};
+            if (!accessMappedPages(cutMapped, &mapped)) {
+                throw std::runtime_error("File changed during scan: " + mappedPath->string());
+            }
+            chunks.push_back(mapped.chunk);
+            offset += mapped.chunk.length;
+            continue;
+        }
+        size_t length = cut(data + offset, size - offset);
+        chunks.push_back({calculateXXH64(data + offset, length), static_cast<uint32_t>(length)});
+        offset += length;
+    }
+    return offset;
+}
+
+std::vector<Chunk> ContentChunker::chunkFile(const fs::path& filePath, ReadThrottle* throttle) const {
+    std::vector<Chunk> chunks;
+    const size_t bufferSize = std::max(streamBufferBytes, 2 * params_.maxSize);
+    MappedFile mapped;
+    if (mapped.open(filePath)) {
+        if (throttle == nullptr) {
+            chunkData(mapped.data(), mapped.size(), true, chunks, &filePath);
+            return chunks;
+        }
+        // С ограничением скорости страницы отображения затрагиваются порциями; участки те же, что и при разбиении целиком
+        for (size_t offset = 0, end = 0; end < mapped.size();) { // отображаются только непустые файлы
+            const size_t next = std::min(mapped.size(), offset + bufferSize);
+            throttle->acquire(next - end); // каждый байт оплачивается один раз, хотя хвост порции разбивается вместе со следующей
+            end = next;
+            offset += chunkData(mapped.data() + offset, end - offset, end == mapped.size(), chunks, &filePath);
+        }
+        return chunks;
+    }
+    std::ifstream in(filePath, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open file: " + filePath.string());
+    }
+    PooledBuffer buffer(bufferSize);
+    size_t filled = 0; // данные в начале буфера, еще не разбитые на участки
+    for (bool last = false; !last;) {
+        if (throttle != nullptr) {
+            throttle->acquire(bufferSize - filled);
+        }
+        in.read(reinterpret_cast<char*>(buffer.data() + filled), static_cast<std::streamsize>(bufferSize - filled));
+        filled += static_cast<size_t>(in.gcount());
+        last = !in;
+        size_t used = chunkData(buffer.data(), filled, last, chunks);
+        std::memmove(buffer.data(), buffer.data() + used, filled - used);
+        filled -= used;
+    }
+    return chunks;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+class ReadThrottle;
+
+// Размеры участков при разбиении по содержимому
+struct ChunkingParams {
+    size_t averageSize = 8192; // ожидаемый размер участка (степень двойки)
+    size_t minSize = 2048; // участок не короче (кроме последнего участка файла)
+    size_t maxSize = 65536; // участок не длиннее
+};
+
+// Участок файла переменной длины
+struct Chunk {
+    uint64_t fingerprint; // xxHash64 содержимого участка
+    uint32_t length; // длина участка в байтах
+};
+
+// Разбиение данных на участки по содержимому (FastCDC): граница ставится там, где скользящий Gear-хэш последних байтов
+// дает нули под маской, поэтому вставка или удаление байтов меняет только соседние участки, а не все последующие.
+// Первые minSize байтов участка не проверяются, до averageSize маска строже, после - мягче (нормализованное разбиение).
+// Таблица Gear-хэша фиксирована: одинаковое содержимое дает одинаковые участки на любой машине и при любом запуске
+class ContentChunker {
+public:
+    explicit ContentChunker(ChunkingParams params = ChunkingParams());
+
+    const ChunkingParams& params() const { return params_; }
+    // Длина первого участка данных; size меньше maxSize означает, что данные заканчиваются концом файла
+    size_t cut(const unsigned char* data, size_t size) const;
+    // Участки файла целиком (отображение в память, для остальных файлов - чтение потоком); если задан throttle,
+    // файл читается порциями, каждая из которых ждет его разрешения
+    std::vector<Chunk> chunkFile(const std::filesystem::path& filePath, ReadThrottle* throttle = nullptr) const;
+
+private:
+    // Добавление участков данных в chunks; возвращает длину разбитой части (вся длина, если last).
+    // mappedPath - файл, из отображения которого взяты данные: если его укоротят, выбрасывается исключение (nullptr - данные в буфере)
+    size_t chunkData(const unsigned char* data, size_t size, bool last, std::vector<Chunk>& chunks, const std::filesystem::path* mappedPath = nullptr) const;
+
+    ChunkingParams params_;
+    uint64_t strictMask_; // маска до averageSize (больше битов - граница реже)
+    uint64_t looseMask_; // маска после averageSize
+};
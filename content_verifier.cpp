@@ -0,0 +1,185 @@
+#include "content_verifier.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include "buffer_pool.h"
+#include "resource_governor.h"
+#include "sha256.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t bufferAlignment = PooledBuffer::alignment; // порции кратны странице
+constexpr size_t maxChunkBytes = 1024 * 1024; // размер порции чтения одного файла
+constexpr size_t minChunkBytes = 64 * 1024;
+constexpr size_t groupBufferBytes = 32 * 1024 * 1024; // память под буферы при синхронном чтении группы
+constexpr size_t maxOpenFiles = 64; // количество одновременно открытых файлов группы
+
+// Функция для открытия файла группы; false - файл удален после обхода и выбывает из группы
+bool openFile(const fs::path& path, std::ifstream& file) {
+    file.open(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot open file: " + path.string() + ", skipping the file\n";
+        return false;
+    }
+    return true;
+}
+
+// Функция для чтения следующей порции файла; false - файл стал короче и выбывает из группы, как и при хэшировании блоков
+bool readChunk(std::ifstream& file, const fs::path& path, unsigned char* buffer, size_t size, ReadThrottle* throttle) {
+    if (throttle != nullptr) {
+        throttle->acquire(size);
+    }
+    if (!file.read(reinterpret_cast<char*>(buffer), static_cast<std::streamsize>(size))) {
+        std::cerr << "File changed during scan: " + path.string() + ", skipping the file\n";
+        return false;
+    }
+    return true;
+}
+
+// Проверка по SHA-256: каждый файл читается один раз, группа делится по значениям хэша
+std::vector<std::vector<size_t>> confirmBySha256(const std::vector<fs::path>& paths, uint64_t fileSize, uint64_t& bytesRead, ReadThrottle* throttle) {
+    PooledBuffer buffer(maxChunkBytes);
+    std::map<Sha256::Digest, std::vector<size_t>> digests;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        std::ifstream file;
+        bool readable = openFile(paths[i], file);
+        Sha256 sha;
+        for (uint64_t offset = 0; readable && offset < fileSize;) {
+            size_t size = static_cast<size_t>(std::min<uint64_t>(maxChunkBytes, fileSize - offset));
+            readable = readChunk(file, paths[i], buffer.data(), size, throttle);
+            sha.update(buffer.data(), size);
+            offset += size;
+            bytesRead += size;
+        }
+        if (readable) {
+            digests[sha.finish()].push_back(i);
+        }
+    }
+    std::vector<std::vector<size_t>> confirmed;
+    for (auto& digest : digests) {
+        if (digest.second.size() > 1) {
+            confirmed.push_back(std::move(digest.second));
+        }
+    }
+    return confirmed;
+}
+
+// Побайтовая проверка: файлы читаются синхронно порциями и сравниваются с первым файлом группы.
+// Отличившиеся файлы закрываются сразу и проверяются следующим проходом между собой (нужно только при коллизии хэшей)
+std::vector<std::vector<size_t>> confirmByBytes(const std::vector<fs::path>& paths, uint64_t fileSize, uint64_t& bytesRead, ReadThrottle* throttle) {
+    std::vector<std::vector<size_t>> confirmed;
+    std::vector<size_t> pending(paths.size()); // файлы, которые еще не сравнивались между собой
+    for (size_t i = 0; i < pending.size(); ++i) {
+        pending[i] = i;
+    }
+    while (pending.size() > 1) {
+        const size_t reference = pending.front();
+        std::vector<size_t> equal{reference}; // совпавшие с первым файлом
+        std::vector<size_t> different; // отличившиеся от первого файла
+        // Группа больше предела открытых файлов сравнивается с первым файлом по частям
+        for (size_t begin = 1; begin < pending.size(); begin += maxOpenFiles - 1) {
+            const size_t end = std::min(pending.size(), begin + maxOpenFiles - 1);
+            const size_t chunkBytes = std::max(minChunkBytes, std::min(maxChunkBytes, groupBufferBytes / (end - begin + 1) / bufferAlignment * bufferAlignment));
+            std::ifstream referenceFile;
+            bool referenceReadable = openFile(paths[reference], referenceFile);
+            PooledBuffer referenceBuffer(chunkBytes);
+            PooledBuffer buffer(chunkBytes);
+            std::vector<std::ifstream> files(end - begin);
+            std::vector<size_t> active; // номера в files, которые пока совпадают с первым файлом
+            for (size_t i = begin; i < end; ++i) {
+                if (!referenceReadable || openFile(paths[pending[i]], files[i - begin])) { // без первого файла остальные не открываются
+                    active.push_back(i - begin);
+                }
+            }
+            for (uint64_t offset = 0; referenceReadable && offset < fileSize && !active.empty();) {
+                size_t size = static_cast<size_t>(std::min<uint64_t>(chunkBytes, fileSize - offset));
+                if (!readChunk(referenceFile, paths[reference], referenceBuffer.data(), size, throttle)) {
+                    referenceReadable = false;
+                    break;
+                }
+                bytesRead += size * (active.size() + 1);
+                auto last = std::remove_if(active.begin(), active.end(), [&](size_t index) {
+                    const fs::path& path = paths[pending[begin + index]];
+                    if (!readChunk(files[index], path, buffer.data(), size, throttle)) {
+                        return true;
+                    }
+                    if (std::memcmp(buffer.data(), referenceBuffer.data(), size) == 0) {
+                        return false;
+                    }
+                    different.push_back(pending[begin + index]);
+                    files[index].close();
+                    return true;
+                });
+                active.erase(last, active.end());
+                offset += size;
+            }
+            if (!referenceReadable) { // первый файл выбыл: остальные сравниваются между собой следующим проходом
+                different.insert(different.end(), equal.begin() + 1, equal.end());
+                for (size_t index : active) {
+                    different.push_back(pending[begin + index]);
+                }
+                different.insert(different.end(), pending.begin() + static_cast<std::ptrdiff_t>(end), pending.end());
+                equal.clear();
+                break;
+            }
+            for (size_t index : active) {
+                equal.push_back(pending[begin + index]);
+            }
+        }
+        if (equal.size() > 1) {
+            confirmed.push_back(std::move(equal));
+        }
+        pending = std::move(different);
+    }
+    return confirmed;
+}
+
+} // namespace
+
+bool parseVerifyMode(const std::string& name, VerifyMode& mode) {
+    if (name == "none") {
+        mode = VerifyMode::None;
+    } else if (name == "sha256") {
+        mode = VerifyMode::Sha256;
+    } else if (name == "bytes") {
+        mode = VerifyMode::Bytes;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* verifyModeName(VerifyMode mode) {
+    switch (mode) {
+    case VerifyMode::Sha256:
+        return "sha256";
+    case VerifyMode::Bytes:
+        return "bytes";
+    default:
+        return "none";
+    }
+}
+
+std::vector<std::vector<size_t>> confirmDuplicates(const std::vector<fs::path>& paths, uint64_t fileSize, VerifyMode mode, uint64_t* bytesRead, ReadThrottle* throttle) {
+    if (paths.size() < 2) {
+        return {};
+    }
+    uint64_t unused = 0;
+    if (mode == VerifyMode::Sha256) {
+        return confirmBySha256(paths, fileSize, bytesRead != nullptr ? *bytesRead : unused, throttle);
+    }
+    if (mode == VerifyMode::Bytes) {
+        return confirmByBytes(paths, fileSize, bytesRead != nullptr ? *bytesRead : unused, throttle);
+    }
+    std::vector<size_t> all(paths.size());
+    for (size_t i = 0; i < all.size(); ++i) {
+        all[i] = i;
+    }
+    return {all};
+}
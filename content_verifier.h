@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class ReadThrottle;
+
+// Окончательная проверка групп, найденных по хэшам блоков
+enum class VerifyMode {
+    None, // группа подтверждается совпадением 32-битных хэшей блоков
+    Sha256, // файлы группы сравниваются по SHA-256 всего содержимого
+    Bytes // файлы группы сравниваются побайтово, все одновременно
+};
+
+// Функция для разбора названия режима проверки ("none", "sha256", "bytes"); возвращает false для неизвестного названия
+bool parseVerifyMode(const std::string& name, VerifyMode& mode);
+
+// Функция для получения названия режима проверки
+const char* verifyModeName(VerifyMode mode);
+
+// Функция для окончательной проверки группы файлов размера fileSize, у которых совпали хэши блоков.
+// Возвращает подгруппы (индексы в paths, не меньше двух в каждой) с действительно одинаковым содержимым.
+// В режиме Bytes файлы группы читаются синхронно большими выровненными буферами и сравниваются с первым файлом,
+// поэтому группа без коллизий проверяется за один проход; при выключенной проверке группа возвращается целиком.
+// Файлы, удаленные или ставшие короче с момента обхода, выбывают из группы с предупреждением в stderr.
+// Если задан bytesRead, к нему добавляется количество прочитанных байтов; если задан throttle, каждая порция ждет его разрешения
+std::vector<std::vector<size_t>> confirmDuplicates(const std::vector<std::filesystem::path>& paths, uint64_t fileSize, VerifyMode mode, uint64_t* bytesRead = nullptr,
+                                                   ReadThrottle* throttle = nullptr);
@@ -0,0 +1,292 @@
+#include "directory_walker.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#if defined(_WIN32)
+#include <chrono>
+#else
+#include <cerrno>
+#include <memory>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/sysmacros.h>
+#endif
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+#if defined(_WIN32)
+// Перебор директории через std::filesystem: на Windows тип, размер и время изменения приходят вместе с элементом (FindNextFile)
+template <typename OnDirectory, typename OnFile>
+void listDirectory(const fs::path& directory, const DirectoryWalker::NameFilter& acceptName, OnDirectory onDirectory, OnFile onFile, std::error_code& error) {
+    fs::directory_iterator it(directory, fs::directory_options::skip_permission_denied, error);
+    for (; !error && it != fs::directory_iterator(); it.increment(error)) {
+        const fs::directory_entry& entry = *it;
+        std::error_code statusError;
+        if (!entry.is_symlink(statusError) && entry.is_directory(statusError)) {
+            onDirectory(entry.path());
+            continue;
+        }
+        const auto& name = entry.path().native();
+        size_t separator = name.find_last_of(L"\\/");
+        if (!acceptName(NativeName(name).substr(separator == name.npos ? 0 : separator + 1)) || !entry.is_regular_file(statusError)) {
+            continue;
+        }
+        FileMetadata metadata;
+        metadata.size = entry.file_size(statusError);
+        metadata.mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(entry.last_write_time(statusError).time_since_epoch()).count();
+        if (!statusError) {
+            onFile(entry.path(), metadata);
+        }
+    }
+}
+
+// Функция для получения времени изменения директории; false - директория недоступна
+bool readDirectoryMtime(const fs::path& directory, int64_t& mtime) {
+    std::error_code error;
+    auto time = fs::last_write_time(directory, error);
+    mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    return !error;
+}
+#else
+// Запрос типа и метаданных элемента директории одним системным вызовом; возвращает false, если элемент недоступен
+bool statEntry(int directoryFd, const char* name, bool followSymlinks, mode_t& type, FileMetadata& metadata) {
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+    struct statx status;
+    int flags = AT_STATX_SYNC_AS_STAT | (followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW);
+    if (::statx(directoryFd, name, flags, STATX_TYPE | STATX_SIZE | STATX_INO | STATX_MTIME, &status) != 0) {
+        return false;
+    }
+    type = status.stx_mode & S_IFMT;
+    metadata.size = status.stx_size;
+    metadata.device = static_cast<uint64_t>(makedev(status.stx_dev_major, status.stx_dev_minor)); // как st_dev у stat
+    metadata.inode = status.stx_ino;
+    metadata.mtime = static_cast<int64_t>(status.stx_mtime.tv_sec) * 1000000000 + status.stx_mtime.tv_nsec;
+#else
+    struct stat status;
+    if (::fstatat(directoryFd, name, &status, followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW) != 0) {
+        return false;
+    }
+    type = status.st_mode & S_IFMT;
+    metadata.size = static_cast<uint64_t>(status.st_size);
+    metadata.device = static_cast<uint64_t>(status.st_dev);
+    metadata.inode = static_cast<uint64_t>(status.st_ino);
+#if defined(__APPLE__)
+    metadata.mtime = static_cast<int64_t>(status.st_mtimespec.tv_sec) * 1000000000 + status.st_mtimespec.tv_nsec;
+#else
+    metadata.mtime = static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+#endif
+    return true;
+}
+
+// Перебор директории через readdir: поддиректории распознаются по d_type без stat, метаданные запрашиваются только для файлов
+template <typename OnDirectory, typename OnFile>
+void listDirectory(const fs::path& directory, const DirectoryWalker::NameFilter& acceptName, OnDirectory onDirectory, OnFile onFile, std::error_code& error) {
+    std::unique_ptr<DIR, int (*)(DIR*)> handle(::opendir(directory.c_str()), ::closedir); // закрывается и при исключении из onFile
+    if (!handle) {
+        if (errno != EACCES) { // как skip_permission_denied у std::filesystem
+            error.assign(errno, std::generic_category());
+        }
+        return;
+    }
+    int directoryFd = ::dirfd(handle.get());
+    while (dirent* entry = ::readdir(handle.get())) {
+        const char* name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) { // "." и ".."
+            continue;
+        }
+        unsigned char type = entry->d_type;
+        FileMetadata metadata;
+        mode_t mode = 0;
+        if (type == DT_UNKNOWN) { // файловая система не сообщает тип - один stat без перехода по ссылке
+            if (!statEntry(directoryFd, name, false, mode, metadata)) {
+                continue;
+            }
+            type = S_ISDIR(mode) ? DT_DIR : S_ISLNK(mode) ? DT_LNK : S_ISREG(mode) ? DT_REG : DT_UNKNOWN;
+            if (type == DT_UNKNOWN) { // устройства, каналы и сокеты
+                continue;
+            }
+        }
+        if (type == DT_DIR) {
+            onDirectory(directory / name);
+            continue;
+        }
+        if ((type != DT_REG && type != DT_LNK) || !acceptName(NativeName(name))) {
+            continue;
+        }
+        if (type == DT_LNK || mode == 0) { // метаданные обычного файла или цели ссылки
+            if (!statEntry(directoryFd, name, true, mode, metadata) || !S_ISREG(mode)) {
+                continue;
+            }
+        }
+        onFile(directory / name, metadata);
+    }
+}
+
+// Функция для получения времени изменения директории; false - директория недоступна
+bool readDirectoryMtime(const fs::path& directory, int64_t& mtime) {
+    mode_t mode = 0;
+    FileMetadata metadata;
+    if (!statEntry(AT_FDCWD, directory.c_str(), true, mode, metadata) || !S_ISDIR(mode)) {
+        return false;
+    }
+    mtime = metadata.mtime;
+    return true;
+}
+#endif
+
+// Директория, ожидающая обхода
+struct DirectoryTask {
+    fs::path path;
+    size_t rootIndex; // номер корня, которому принадлежит директория
+    int depth; // глубина относительно корня
+};
+
+// Очередь директорий одного потока: владелец работает с концом (обход в глубину), другие потоки забирают с начала
+struct WorkQueue {
+    std::mutex mutex;
+    std::deque<DirectoryTask> tasks;
+};
+
+} // namespace
+
+bool readFileMetadata(const fs::path& path, FileMetadata& metadata) {
+#if defined(_WIN32)
+    std::error_code error;
+    if (!fs::is_regular_file(path, error)) {
+        return false;
+    }
+    metadata = FileMetadata();
+    metadata.size = fs::file_size(path, error);
+    metadata.mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(fs::last_write_time(path, error).time_since_epoch()).count();
+    return !error;
+#else
+    mode_t mode = 0;
+    return statEntry(AT_FDCWD, path.c_str(), true, mode, metadata) && S_ISREG(mode);
+#endif
+}
+
+void DirectoryWalker::walk(const std::vector<fs::path>& roots, int maxDepth, const ExcludeCallback& isExcluded, const NameFilter& acceptName, const FileCallback& onFile) const {
+    std::vector<WorkQueue> queues(threadCount_);
+    std::atomic<size_t> pending{roots.size()}; // директории в очередях и в обработке; 0 - обход завершен
+    for (size_t i = 0; i < roots.size(); ++i) {
+        queues[i % threadCount_].tasks.push_back({roots[i], i, 0});
+    }
+    std::mutex errorMutex; // сообщения об ошибках разных потоков не перемешиваются
+    std::exception_ptr callbackError; // первое исключение из onFile, пробрасывается после завершения потоков
+    std::atomic<bool> failed{false};
+
+    auto worker = [&](size_t self) {
+        size_t idleRounds = 0; // количество подряд неудачных попыток найти работу
+        while (pending.load(std::memory_order_acquire) > 0 && !failed.load(std::memory_order_relaxed)) {
+            DirectoryTask task;
+            bool found = false;
+            {
+                std::lock_guard<std::mutex> lock(queues[self].mutex);
+                if (!queues[self].tasks.empty()) {
+                    task = std::move(queues[self].tasks.back());
+                    queues[self].tasks.pop_back();
+                    found = true;
+                }
+            }
+            for (size_t offset = 1; !found && offset < threadCount_; ++offset) { // своя очередь пуста - перехват у соседей
+                WorkQueue& victim = queues[(self + offset) % threadCount_];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty()) {
+                    task = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    found = true;
+                }
+            }
+            if (!found) { // работа осталась только у других потоков, которые читают директории
+                if (++idleRounds < 64) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+                continue;
+            }
+            idleRounds = 0;
+            std::error_code error;
+            try {
+                auto onDirectory = [&](fs::path directory) {
+                    if ((maxDepth < 0 || task.depth < maxDepth) && !isExcluded(task.rootIndex, directory)) {
+                        pending.fetch_add(1, std::memory_order_relaxed);
+                        std::lock_guard<std::mutex> lock(queues[self].mutex);
+                        queues[self].tasks.push_back({std::move(directory), task.rootIndex, task.depth + 1});
+                    }
+                };
+                if (listings_ == nullptr) {
+                    listDirectory(task.path, acceptName, onDirectory, [&](fs::path path, const FileMetadata& metadata) { onFile(self, task.rootIndex, std::move(path), metadata); }, error);
+                } else { // время изменения запрашивается до чтения: изменение во время чтения заставит прочитать директорию в следующий раз
+                    DirectoryListing previous;
+                    DirectoryListing listing;
+                    bool known = readDirectoryMtime(task.path, listing.mtime);
+                    if (known && listings_->find(task.path, listing.mtime, previous)) { // содержимое не изменилось, readdir не нужен
+                        for (auto& name : previous.subdirectories) {
+                            onDirectory(task.path / name);
+                            listing.subdirectories.push_back(std::move(name));
+                        }
+                        for (auto& file : previous.files) {
+                            fs::path path = task.path / file.name;
+                            if (!acceptName(NativeName(file.name)) || !readFileMetadata(path, file.metadata)) { // файл удален
+                                continue;
+                            }
+                            onFile(self, task.rootIndex, std::move(path), file.metadata);
+                            listing.files.push_back({std::move(file.name), file.metadata});
+                        }
+                    } else {
+                        listDirectory(task.path, acceptName,
+                            [&](fs::path directory) {
+                                listing.subdirectories.push_back(directory.filename().native());
+                                onDirectory(std::move(directory));
+                            },
+                            [&](fs::path path, const FileMetadata& metadata) {
+                                listing.files.push_back({path.filename().native(), metadata});
+                                onFile(self, task.rootIndex, std::move(path), metadata);
+                            },
+                            error);
+                    }
+                    if (known && !error) {
+                        listings_->record(task.path, std::move(listing));
+                    }
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!callbackError) {
+                    callbackError = std::current_exception();
+                }
+                failed.store(true, std::memory_order_relaxed);
+            }
+            if (error) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                std::cerr << "Cannot read directory " << task.path << ": " << error.message() << std::endl;
+            }
+            pending.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount_; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0); // вызывающий поток тоже обходит директории
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (callbackError) {
+        std::rethrow_exception(callbackError);
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+// Метаданные файла, полученные один раз при обходе; дальше по конвейеру файловая система для них не запрашивается
+struct FileMetadata {
+    uint64_t size = 0; // размер файла
+    uint64_t device = 0; // устройство
+    uint64_t inode = 0; // inode (0 - неизвестен, например на Windows)
+    int64_t mtime = 0; // время последнего изменения в наносекундах
+};
+
+// Имя элемента директории в представлении операционной системы (без копирования)
+using NativeName = std::basic_string_view<std::filesystem::path::value_type>;
+
+// Функция для получения метаданных обычного файла по пути (с переходом по символической ссылке);
+// возвращает false, если файл недоступен или не является обычным файлом
+bool readFileMetadata(const std::filesystem::path& path, FileMetadata& metadata);
+
+// Файл из сохраненного содержимого директории
+struct ListedFile {
+    std::filesystem::path::string_type name; // имя файла
+    FileMetadata metadata; // метаданные при прошлом чтении
+};
+
+// Содержимое директории: поддиректории и файлы, принятые фильтром имен
+struct DirectoryListing {
+    int64_t mtime = 0; // время изменения директории при чтении в наносекундах
+    std::vector<std::filesystem::path::string_type> subdirectories; // имена поддиректорий
+    std::vector<ListedFile> files; // файлы
+};
+
+// Хранилище содержимого директорий для инкрементального обхода: директория, время изменения которой не изменилось,
+// не читается заново (добавление, удаление и переименование элементов меняют время изменения директории).
+// Метаданные ее файлов все равно запрашиваются заново: изменение файла на месте не меняет время изменения директории
+class ListingStore {
+public:
+    virtual ~ListingStore() = default;
+
+    // Заполнение listing сохраненным содержимым директории с временем изменения mtime; false - директорию нужно прочитать
+    virtual bool find(const std::filesystem::path& directory, int64_t mtime, DirectoryListing& listing) const = 0;
+    // Запоминание содержимого директории, полученного при обходе (вызывается из потоков обхода одновременно)
+    virtual void record(const std::filesystem::path& directory, DirectoryListing listing) = 0;
+};
+
+// Источник файлов для поиска дубликатов: обходит корни и сообщает о каждом файле вместе с его метаданными
+class FileWalker {
+public:
+    // Возвращает true, если элемент с таким именем нужно рассматривать (вызывается до запроса метаданных)
+    using NameFilter = std::function<bool(NativeName name)>;
+    // Вызывается для каждого обычного файла (в том числе по символической ссылке), имя которого принял фильтр
+    using FileCallback = std::function<void(size_t worker, size_t rootIndex, std::filesystem::path path, const FileMetadata& metadata)>;
+    // Возвращает true, если поддиректорию корня rootIndex не нужно обходить
+    using ExcludeCallback = std::function<bool(size_t rootIndex, const std::filesystem::path& directory)>;
+
+    virtual ~FileWalker() = default;
+
+    // Количество потоков, из которых вызываются функции обратного вызова (номер worker в FileCallback меньше этого значения)
+    virtual size_t threadCount() const = 0;
+
+    // Обход корней roots на глубину maxDepth (0 - только сами корни, отрицательное значение - без ограничения);
+    // функции обратного вызова могут вызываться из разных потоков одновременно
+    virtual void walk(const std::vector<std::filesystem::path>& roots, int maxDepth, const ExcludeCallback& isExcluded, const NameFilter& acceptName, const FileCallback& onFile) const = 0;
+};
+
+// Параллельный обход деревьев директорий с перехватом работы (work stealing):
+// у каждого потока своя очередь директорий, свободный поток забирает самые старые (крупные) поддеревья из чужих очередей.
+// На POSIX директории читаются через readdir с типом элемента из d_type, а метаданные файла запрашиваются
+// одним вызовом statx (Linux) или fstatat относительно дескриптора директории
+class DirectoryWalker : public FileWalker {
+public:
+    explicit DirectoryWalker(size_t threadCount) : threadCount_(threadCount == 0 ? 1 : threadCount) {}
+
+    size_t threadCount() const override { return threadCount_; }
+
+    // Подключение хранилища содержимого директорий (nullptr - все директории читаются заново)
+    void setListingStore(ListingStore* listings) { listings_ = listings; }
+
+    // Символические ссылки на директории не раскрываются, недоступные директории пропускаются с сообщением в std::cerr
+    void walk(const std::vector<std::filesystem::path>& roots, int maxDepth, const ExcludeCallback& isExcluded, const NameFilter& acceptName, const FileCallback& onFile) const override;
+
+private:
+    size_t threadCount_; // количество потоков обхода
+    ListingStore* listings_ = nullptr; // сохраненное содержимое директорий
+};
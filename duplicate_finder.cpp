@@ -0,0 +1,929 @@
+#include "duplicate_finder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
+
+#include "async_reader.h"
+#include "candidate_spill.h"
+#include "content_chunker.h"
+#include "file_reader.h"
+#include "file_table.h"
+#include "glob_matcher.h"
+#include "hash_cache.h"
+#include "hash_sequence.h"
+#include "io_scheduler.h"
+#include "partial_index.h"
+#include "resource_governor.h"
+#include "scan_snapshot.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Буфер асинхронного чтения, переданный задаче хэширования; возвращается в пул при уничтожении задачи, даже если она не выполнялась
+struct BufferLease {
+    BufferLease(AsyncReader& reader, const AsyncReader::Completion& completion) : reader(reader), completion(completion) {}
+    BufferLease(const BufferLease&) = delete;
+    BufferLease& operator=(const BufferLease&) = delete;
+    ~BufferLease() {
+        if (completion.data != nullptr) {
+            reader.release(completion.buffer);
+        }
+    }
+
+    AsyncReader& reader;
+    AsyncReader::Completion completion;
+};
+
+constexpr size_t asyncQueueDepth = 64; // количество одновременных асинхронных чтений
+constexpr size_t maxAsyncBlockBytes = 1024 * 1024; // первые блоки большего размера читаются рабочими потоками
+
+// Пул рабочих потоков с ограниченной очередью задач: submit блокируется, пока очередь заполнена
+class WorkerPool {
+public:
+    WorkerPool(size_t threadCount, size_t queueCapacity) : queueCapacity_(std::max<size_t>(queueCapacity, 1)) {
+        for (size_t i = 0; i < std::max<size_t>(threadCount, 1); ++i) {
+            threads_.emplace_back([this] { run(); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        taskAdded_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    // Добавление задачи в очередь
+    void submit(std::function<void()> task) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        taskTaken_.wait(lock, [this] { return queue_.size() < queueCapacity_; });
+        queue_.push_back(std::move(task));
+        taskAdded_.notify_one();
+    }
+
+    // Ожидание завершения всех задач; первое исключение из задач пробрасывается вызывающему
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return queue_.empty() && activeTasks_ == 0; });
+        if (error_) {
+            std::exception_ptr error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    void run() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                taskAdded_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+                if (queue_.empty()) { // пул останавливается и задач не осталось
+                    return;
+                }
+                task = std::move(queue_.front());
+                queue_.pop_front();
+                ++activeTasks_;
+                taskTaken_.notify_one();
+                if (error_) { // после ошибки оставшиеся задачи не выполняются
+                    task = nullptr;
+                }
+            }
+            if (task) {
+                try {
+                    task();
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!error_) {
+                        error_ = std::current_exception();
+                    }
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--activeTasks_ == 0 && queue_.empty()) {
+                idle_.notify_all();
+            }
+        }
+    }
+
+    size_t queueCapacity_; // максимальное количество задач в очереди
+    std::vector<std::thread> threads_; // рабочие потоки
+    std::deque<std::function<void()>> queue_; // очередь задач
+    std::mutex mutex_;
+    std::condition_variable taskAdded_; // в очереди появилась задача
+    std::condition_variable taskTaken_; // в очереди освободилось место
+    std::condition_variable idle_; // все задачи выполнены
+    size_t activeTasks_ = 0; // количество выполняющихся задач
+    bool stopping_ = false; // пул останавливается
+    std::exception_ptr error_; // первое исключение, выброшенное задачей
+};
+
+using PathSet = std::unordered_set<fs::path::string_type>; // множество нормализованных путей
+
+constexpr size_t maxSharedFiles = 64; // участки, общие для большего числа файлов, не учитываются в сходстве пар
+constexpr size_t minSpillBytes = 1024 * 1024; // наименьшая таблица потока обхода, которая записывается во временный файл
+constexpr size_t hashingBytesPerFile = 128; // память findGroups на кандидата сверх таблицы: последовательность хэшей, ссылки, ключ кэша, порядок чтения
+
+// Функция для нормализации пути директории без завершающего разделителя
+fs::path::string_type normalizedDirectory(const fs::path& path) {
+    fs::path normal = path.lexically_normal();
+    if (normal.has_relative_path() && !normal.has_filename()) { // "a/b/" -> "a/b"
+        normal = normal.parent_path();
+    }
+    return normal.native();
+}
+
+// Функция для построения множества исключенных директорий в терминах путей, которые выдает обход корня root:
+// исключение, заданное относительным или абсолютным путем, переводится в путь относительно root
+PathSet excludedDirectories(const fs::path& root, const std::vector<fs::path>& exclusions) {
+    PathSet excluded;
+    std::error_code error;
+    fs::path canonicalRoot = fs::weakly_canonical(root, error);
+    for (const auto& exclusion : exclusions) {
+        excluded.insert(normalizedDirectory(exclusion));
+        fs::path canonicalExclusion = fs::weakly_canonical(exclusion, error);
+        if (error || canonicalRoot.empty()) {
+            continue;
+        }
+        fs::path relative = canonicalExclusion.lexically_relative(canonicalRoot);
+        if (!relative.empty() && *relative.begin() != "..") { // исключение лежит внутри root
+            excluded.insert(normalizedDirectory(root / relative));
+        }
+    }
+    return excluded;
+}
+
+// Функция для обработки файла
+void processFile(const fs::path& path, const FileMetadata& metadata, size_t minSize, FileTable& candidates, ScanMetrics& metrics) {
+    if (metadata.size < minSize) { // если размер файла меньше минимального размера
+        metrics.filesFiltered.add(1);
+        return;
+    }
+    candidates.add(path, metadata); // хэширование откладывается до группировки по размеру
+}
+
+// Функция для получения описания параметров, от которых зависит результат поиска: снимок с другими параметрами не используется
+std::string snapshotFingerprint(const FinderConfig& config, const BlockHasher& hasher) {
+    std::ostringstream out;
+    auto list = [&out](const char* name, const auto& items) {
+        out << name << '=' << items.size();
+        for (const auto& item : items) {
+            std::string text = fs::path(item).string();
+            out << ' ' << text.size() << ':' << text;
+        }
+        out << '\n';
+    };
+    list("directories", config.directories);
+    list("exclusions", config.exclusions);
+    list("masks", config.masks);
+    list("excludeMasks", config.excludeMasks);
+    out << "level=" << config.scanLevel << " caseSensitive=" << config.caseSensitive << " minSize=" << config.minSize << " blockSize=" << config.blockSize
+        << " strategy=" << blockStrategyName(config.strategy) << " hash=" << hashAlgorithmName(hasher.algorithm) << " verify=" << verifyModeName(config.verify);
+    return out.str();
+}
+
+// Функция для сравнения метаданных файла
+bool sameMetadata(const FileMetadata& left, const FileMetadata& right) {
+    return left.size == right.size && left.device == right.device && left.inode == right.inode && left.mtime == right.mtime;
+}
+
+// Изменения относительно снимка прошлого поиска
+struct SnapshotChanges {
+    std::vector<ScanSnapshot::PreviousFile> previous; // файл снимка для неизмененных кандидатов (index == SIZE_MAX - файл новый или изменился)
+    std::vector<bool> missing; // кандидаты, исчезнувшие после обхода
+    std::unordered_set<uint64_t> dirtySizes; // размеры, среди файлов которых есть новые, измененные или удаленные
+};
+
+// Функция для сравнения кандидатов со снимком. Метаданные всех файлов запрошены при обходе, но файлы могли измениться после него,
+// поэтому неизмененные на вид файлы размеров с изменениями перепроверяются, пока множество таких размеров растет;
+// группы остальных размеров берутся из снимка без чтения файлов
+SnapshotChanges findChanges(const ScanSnapshot& snapshot, FileTable& candidates, uint64_t minSize, WorkerPool& pool) {
+    SnapshotChanges changes;
+    changes.previous.resize(candidates.size());
+    changes.missing.assign(candidates.size(), false);
+    std::vector<bool> seen(snapshot.previousCount(), false); // файлы снимка, найденные при обходе
+    NativeName lastDirectory; // файлы одной директории идут в таблице подряд и ссылаются на одну строку
+    size_t directory = SIZE_MAX;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (candidates.directory(i).data() != lastDirectory.data()) {
+            lastDirectory = candidates.directory(i);
+            directory = snapshot.previousDirectory(lastDirectory);
+        }
+        ScanSnapshot::PreviousFile file = snapshot.previous(directory, candidates.name(i));
+        if (file.index != SIZE_MAX) {
+            seen[file.index] = true;
+            if (sameMetadata(file.metadata, candidates.metadata(i))) {
+                changes.previous[i] = file;
+                continue;
+            }
+            changes.dirtySizes.insert(file.metadata.size);
+        }
+        changes.dirtySizes.insert(candidates.fileSize(i));
+    }
+    snapshot.forEachPrevious([&](const ScanSnapshot::PreviousFile& file) {
+        if (!seen[file.index] && file.metadata.size >= minSize) { // файл удален (или исключен из обхода)
+            changes.dirtySizes.insert(file.metadata.size);
+        }
+    });
+    std::vector<bool> rechecked(candidates.size(), false);
+    for (bool grown = true; grown;) {
+        std::vector<uint32_t> suspects; // неизмененные на вид файлы размеров с изменениями
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            if (changes.previous[i].index != SIZE_MAX && !rechecked[i] && changes.dirtySizes.count(candidates.fileSize(i)) > 0) {
+                suspects.push_back(static_cast<uint32_t>(i));
+                rechecked[i] = true;
+            }
+        }
+        std::vector<FileMetadata> current(suspects.size());
+        std::vector<char> exists(suspects.size(), 0);
+        const size_t chunkSize = 256;
+        for (size_t first = 0; first < suspects.size(); first += chunkSize) {
+            pool.submit([&, first] {
+                for (size_t k = first; k < std::min(first + chunkSize, suspects.size()); ++k) {
+                    exists[k] = readFileMetadata(candidates.path(suspects[k]), current[k]) ? 1 : 0;
+                }
+            });
+        }
+        pool.wait();
+        grown = false;
+        for (size_t k = 0; k < suspects.size(); ++k) {
+            const uint32_t i = suspects[k];
+            if (exists[k] && sameMetadata(current[k], candidates.metadata(i))) {
+                continue;
+            }
+            changes.previous[i] = ScanSnapshot::PreviousFile();
+            if (!exists[k]) {
+                changes.missing[i] = true;
+            } else {
+                candidates.setMetadata(i, current[k]);
+                grown = changes.dirtySizes.insert(current[k].size).second || grown;
+            }
+        }
+    }
+    return changes;
+}
+
+// Функция для перевода потока поиска в класс ввода-вывода idle, если это задано ограничениями (потоки поиска создаются позже и наследуют его)
+void applyIoPriority(const ResourceLimits& limits) {
+    static std::atomic<bool> warned{false}; // режим наблюдения вызывает run много раз, предупреждение выводится один раз
+    if (limits.idleIo && !setIdleIoPriority() && !warned.exchange(true)) {
+        std::cerr << "Cannot lower I/O priority to idle, reading with the normal priority" << std::endl;
+    }
+}
+
+// Функция для создания ограничения скорости чтения; nullptr - скорость не ограничена
+std::unique_ptr<ReadThrottle> createThrottle(const ResourceLimits& limits, ScanMetrics& metrics) {
+    return limits.readBytesPerSecond > 0 ? std::make_unique<ReadThrottle>(limits.readBytesPerSecond, &metrics.throttleNanos) : nullptr;
+}
+
+// Объекты одного поиска, общие для всех порций кандидатов
+struct ScanResources {
+    const FinderConfig& settings;
+    const BlockHasher& hasher;
+    ScanMetrics& metrics;
+    StageTimer& stages;
+    WorkerPool& pool;
+    IoScheduler& scheduler;
+    AsyncReader* reader; // nullptr - первые блоки читаются рабочими потоками
+    ReadThrottle* throttle; // nullptr - скорость чтения не ограничена
+    HashCache* cache; // nullptr - кэш не используется
+    ScanSnapshot* snapshot; // nullptr - снимок не ведется
+    size_t threadCount;
+};
+
+// Функция для поиска групп дубликатов среди кандидатов: группировка по размеру, хэширование первых блоков, сравнение групп
+// и вывод в onGroup по возрастанию размера файлов. Вычисленные хэши добавляются в кэш, кандидаты с их группами - в снимок
+void findGroups(const FileTable& candidates, const SnapshotChanges& changes, const GroupCallback& onGroup, const ScanResources& scan) {
+    const FinderConfig& settings = scan.settings;
+    const size_t blockSize = settings.blockSize;
+    const size_t threadCount = scan.threadCount;
+    const BlockHasher& hasher = scan.hasher;
+    ScanMetrics& metrics = scan.metrics;
+    StageTimer& stages = scan.stages;
+    WorkerPool& pool = scan.pool;
+    IoScheduler& scheduler = scan.scheduler;
+    AsyncReader* reader = scan.reader;
+    // Группировка сортировкой индексов: файлы одного размера, а среди них жесткие ссылки на один inode, оказываются рядом.
+    // Порядок обхода зависит от потоков, результат - нет: пути в выводе сортируются
+    std::vector<uint32_t> order;
+    order.reserve(candidates.size());
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (changes.missing.empty() || !changes.missing[i]) {
+            order.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    std::sort(order.begin(), order.end(), [&candidates](uint32_t left, uint32_t right) {
+        return std::make_tuple(candidates.fileSize(left), candidates.device(left), candidates.inode(left), left) <
+               std::make_tuple(candidates.fileSize(right), candidates.device(right), candidates.inode(right), right);
+    });
+    // Ленивые последовательности хэшей создаются только для файлов, размер которых встречается больше одного раза
+    const BlockLayout layout(settings.strategy, blockSize);
+    const HashingContext context{candidates, layout, hasher, &metrics, &scheduler, settings.cacheMode, scan.throttle};
+    // Пути с общими устройством и inode (жесткие ссылки) заведомо одинаковы: такой файл читается один раз
+    std::vector<LazyHashSequence> files; // последовательности хэшей всех файлов-кандидатов (по одной на inode)
+    std::vector<uint32_t> links; // индексы кандидатов: ссылки на files[i] занимают диапазон [linkStarts[i], linkStarts[i + 1])
+    std::vector<uint32_t> linkStarts;
+    std::vector<std::pair<size_t, size_t>> groups; // диапазоны индексов files для групп одного размера
+    std::vector<bool> reusedGroups; // группы размеров без изменений: дубликаты берутся из снимка
+    std::vector<char> reusedFiles; // файлы таких групп не читаются
+    for (size_t begin = 0, end = 0; begin < order.size(); begin = end) {
+        const uint64_t size = candidates.fileSize(order[begin]);
+        while (end < order.size() && candidates.fileSize(order[end]) == size) {
+            ++end;
+        }
+        if (end - begin < 2) { // файл с уникальным размером не может иметь дубликатов, его не нужно читать
+            continue;
+        }
+        size_t first = files.size();
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t file = order[i];
+            const uint32_t previous = i > begin ? order[i - 1] : file;
+            if (i == begin || candidates.inode(file) == 0 || candidates.inode(file) != candidates.inode(previous) || candidates.device(file) != candidates.device(previous)) {
+                files.emplace_back(context, file); // новый inode (inode неизвестен только на Windows)
+                linkStarts.push_back(static_cast<uint32_t>(links.size()));
+            }
+            links.push_back(file);
+        }
+        groups.emplace_back(first, files.size());
+        reusedGroups.push_back(!changes.previous.empty() && changes.dirtySizes.count(size) == 0);
+        reusedFiles.resize(files.size(), reusedGroups.back() ? 1 : 0);
+        metrics.candidates.add(end - begin);
+        metrics.sizesReused.add(reusedGroups.back() ? 1 : 0);
+    }
+    linkStarts.push_back(static_cast<uint32_t>(links.size()));
+    order = std::vector<uint32_t>();
+    stages.next(ScanStage::Hash);
+    std::vector<CacheKey> cacheKeys(scan.cache == nullptr ? 0 : files.size()); // ключи кэша кандидатов (blockSize == 0 - файл недоступен)
+    // Хэширование первых блоков всех кандидатов порциями, чтобы большие группы одного размера тоже читались параллельно
+    const size_t chunkSize = 64; // количество файлов в одной задаче
+    for (size_t first = 0; first < files.size(); first += chunkSize) {
+        pool.submit([&files, &candidates, &scan, &cacheKeys, &changes, first, chunkSize, blockSize, &layout, &hasher] {
+            for (size_t i = first; i < std::min(first + chunkSize, files.size()); ++i) {
+                if (!changes.previous.empty() && changes.previous[files[i].file()].hashes != nullptr) { // хэши неизмененного файла из снимка
+                    files[i].preload(*changes.previous[files[i].file()].hashes);
+                }
+                if (!cacheKeys.empty()) { // подстановка хэшей из кэша, пока файл не изменился
+                    CacheKey& key = cacheKeys[i];
+                    const FileMetadata metadata = candidates.metadata(files[i].file());
+                    key.device = metadata.device;
+                    key.inode = metadata.inode;
+                    key.mtime = metadata.mtime;
+                    if (key.inode != 0 || readFileIdentity(files[i].path(), key)) { // inode неизвестен после обхода только на Windows
+                        key.size = files[i].fileSize();
+                        key.blockSize = static_cast<uint32_t>(blockSize);
+                        key.algorithm = static_cast<uint16_t>(hasher.algorithm);
+                        key.strategy = static_cast<uint16_t>(layout.strategy());
+                        std::vector<uint32_t> cached;
+                        if (scan.cache->find(key, cached)) {
+                            files[i].preload(cached);
+                        }
+                    }
+                }
+            }
+        });
+    }
+    pool.wait();
+    // Файлы без хэша первого блока читаются по устройствам, внутри устройства - в порядке расположения на диске
+    std::vector<uint32_t> unread; // кандидаты без хэшей из снимка и кэша
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!reusedFiles[i] && files[i].blockCount() > 0 && files[i].computedCount() == 0) {
+            unread.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    std::vector<IoScheduler::Locality> locality(files.size()); // ключи порядка чтения (на вращающихся дисках - FIEMAP, это вызов на файл)
+    for (size_t first = 0; first < unread.size(); first += chunkSize) {
+        pool.submit([&files, &candidates, &scheduler, &unread, &locality, first, chunkSize] {
+            for (size_t k = first; k < std::min(first + chunkSize, unread.size()); ++k) {
+                const uint32_t file = files[unread[k]].file();
+                locality[unread[k]] = scheduler.locality(files[unread[k]].path(), candidates.device(file), candidates.inode(file));
+            }
+        });
+    }
+    pool.wait();
+    std::sort(unread.begin(), unread.end(), [&files, &candidates, &locality](uint32_t left, uint32_t right) {
+        return std::make_tuple(candidates.device(files[left].file()), locality[left], left) < std::make_tuple(candidates.device(files[right].file()), locality[right], right);
+    });
+    locality = std::vector<IoScheduler::Locality>();
+    if (!reader) {
+        // Цепочки чтений: у устройства не больше limit цепочек, каждая берет следующий по порядку файл устройства.
+        // Рабочие потоки не ждут занятое устройство, пока у других устройств есть файлы
+        std::vector<std::pair<size_t, size_t>> devices; // диапазоны unread по устройствам
+        for (size_t begin = 0, end = 0; begin < unread.size(); begin = end) {
+            const uint64_t device = candidates.device(files[unread[begin]].file());
+            while (end < unread.size() && candidates.device(files[unread[end]].file()) == device) {
+                ++end;
+            }
+            devices.emplace_back(begin, end);
+        }
+        std::unique_ptr<std::atomic<size_t>[]> cursors(new std::atomic<size_t>[devices.size()]); // следующие файлы устройств
+        std::vector<size_t> chains(devices.size()); // количество цепочек устройств
+        for (size_t d = 0; d < devices.size(); ++d) {
+            cursors[d] = devices[d].first;
+            chains[d] = std::min({scheduler.limit(candidates.device(files[unread[devices[d].first]].file())), threadCount, devices[d].second - devices[d].first});
+        }
+        const size_t rounds = chains.empty() ? 0 : *std::max_element(chains.begin(), chains.end());
+        for (size_t round = 0; round < rounds; ++round) { // цепочки разных устройств чередуются в очереди пула
+            for (size_t d = 0; d < devices.size(); ++d) {
+                if (round < chains[d]) {
+                    pool.submit([&files, &unread, &devices, &cursors, d] {
+                        uint32_t hash;
+                        for (size_t k = cursors[d]++; k < devices[d].second; k = cursors[d]++) {
+                            files[unread[k]].tryHashAt(0, hash);
+                        }
+                    });
+                }
+            }
+        }
+        pool.wait();
+    } else { // первые блоки читаются асинхронно: пока рабочие потоки хэшируют прочитанное, в работе остаются следующие чтения
+        reader->read(unread.size(),
+            [&](size_t index) {
+                const LazyHashSequence& file = files[unread[index]];
+                FileRange range = layout.block(file.fileSize(), 0);
+                const uint64_t device = candidates.device(file.file());
+                if (scan.throttle != nullptr) { // запросы берутся по мере освобождения очереди: ожидание задерживает следующие чтения
+                    scan.throttle->acquire(range.length);
+                }
+                return AsyncReader::Request{file.path(), range.offset, static_cast<size_t>(range.length), device, scheduler.limit(device),
+                                            settings.cacheMode != CacheMode::Keep};
+            },
+            [&](const AsyncReader::Completion& completion) {
+                auto lease = std::make_shared<BufferLease>(*reader, completion);
+                pool.submit([&files, &unread, &layout, &hasher, &metrics, lease] {
+                    const AsyncReader::Completion& read = lease->completion;
+                    LazyHashSequence& file = files[unread[read.request]];
+                    FileRange range = layout.block(file.fileSize(), 0);
+                    size_t expected = static_cast<size_t>(std::min(range.length, file.fileSize() - range.offset));
+                    if (read.data != nullptr && read.size >= expected) {
+                        std::fill(read.data + read.size, read.data + range.length, 0); // неполный блок фиксированного разбиения дополняется нулями
+                        file.setFirstHash(hasher.forSize(static_cast<size_t>(range.length))(read.data, static_cast<size_t>(range.length)));
+                        metrics.filesHashed.add(1);
+                        metrics.blocksHashed.add(1);
+                        metrics.bytesRead.add(expected);
+                    } else { // ошибка или неполное чтение: синхронное чтение сообщит об ошибке так же, как без io_uring
+                        uint32_t hash;
+                        file.tryHashAt(0, hash);
+                    }
+                });
+            });
+        pool.wait();
+    }
+    // Сравнение хешей внутри групп одного размера; найденные группы выводятся сразу, в порядке размеров файлов
+    stages.next(ScanStage::Compare);
+    OrderedResultWriter writer(onGroup, groups.size());
+    std::vector<uint32_t> groupIds(files.size(), 0); // номера найденных групп для снимка (0 - файл не входит в группы)
+    std::atomic<uint32_t> nextGroupId{1};
+    for (size_t task = 0; task < groups.size(); ++task) {
+        pool.submit([&, task] {
+            const size_t first = groups[task].first;
+            const size_t last = groups[task].second;
+            std::vector<std::vector<LazyHashSequence*>> identical; // группы файлов с одинаковым содержимым
+            if (reusedGroups[task]) { // файлы этого размера не менялись: группы прошлого поиска остаются в силе
+                std::map<uint32_t, std::vector<LazyHashSequence*>> previousGroups;
+                for (size_t i = first; i < last; ++i) {
+                    uint32_t group = changes.previous[links[linkStarts[i]]].group;
+                    if (group != 0) {
+                        previousGroups[group].push_back(&files[i]);
+                    }
+                }
+                for (auto& item : previousGroups) {
+                    if (item.second.size() > 1) {
+                        identical.push_back(std::move(item.second));
+                    }
+                }
+            } else if (last - first > 1) { // сравнивать нужно только разные inode
+                std::vector<LazyHashSequence*> group;
+                for (size_t i = first; i < last; ++i) {
+                    group.push_back(&files[i]);
+                }
+                refineGroup(std::move(group), identical);
+            }
+            if (settings.verify != VerifyMode::None && !reusedGroups[task]) { // совпадение 32-битных хэшей подтверждается сравнением содержимого
+                ScopedNanos timer(metrics.verifyNanos);
+                uint64_t bytesRead = 0;
+                std::vector<std::vector<LazyHashSequence*>> confirmed;
+                for (const auto& part : identical) {
+                    std::vector<fs::path> paths;
+                    for (const auto* file : part) {
+                        paths.push_back(file->path());
+                    }
+                    for (const auto& indices : confirmDuplicates(paths, files[first].fileSize(), settings.verify, &bytesRead, scan.throttle)) {
+                        confirmed.emplace_back();
+                        for (size_t index : indices) {
+                            confirmed.back().push_back(part[index]);
+                        }
+                    }
+                }
+                identical = std::move(confirmed);
+                metrics.bytesRead.add(bytesRead);
+            }
+            std::vector<bool> reported(last - first, false); // файл уже попал в группу дубликатов
+            std::vector<DuplicateGroup> duplicates;
+            auto addFile = [&](DuplicateGroup& duplicate, size_t index, uint32_t id) {
+                reported[index - first] = true;
+                groupIds[index] = id;
+                std::vector<fs::path> paths;
+                for (uint32_t link = linkStarts[index]; link < linkStarts[index + 1]; ++link) {
+                    paths.push_back(candidates.path(links[link]));
+                }
+                std::sort(paths.begin(), paths.end()); // порядок ссылок в таблице зависит от потоков обхода
+                duplicate.files.insert(duplicate.files.end(), paths.begin(), paths.end());
+                if (paths.size() > 1) {
+                    duplicate.hardlinks.push_back(std::move(paths));
+                }
+            };
+            for (const auto& part : identical) {
+                duplicates.push_back({files[first].fileSize(), {}, {}});
+                uint32_t id = nextGroupId.fetch_add(1, std::memory_order_relaxed);
+                for (const auto* file : part) {
+                    addFile(duplicates.back(), static_cast<size_t>(file - files.data()), id);
+                }
+            }
+            for (size_t i = first; i < last; ++i) {
+                if (!reported[i - first] && !files[i].failed() && linkStarts[i + 1] - linkStarts[i] > 1) { // файл без копий, но с несколькими жесткими ссылками
+                    duplicates.push_back({files[first].fileSize(), {}, {}});
+                    addFile(duplicates.back(), i, nextGroupId.fetch_add(1, std::memory_order_relaxed));
+                }
+            }
+            for (auto& duplicate : duplicates) {
+                std::sort(duplicate.files.begin(), duplicate.files.end());
+                std::sort(duplicate.hardlinks.begin(), duplicate.hardlinks.end());
+            }
+            std::sort(duplicates.begin(), duplicates.end(), [](const DuplicateGroup& left, const DuplicateGroup& right) { return left.files.front() < right.files.front(); });
+            metrics.groups.add(duplicates.size());
+            for (const auto& duplicate : duplicates) {
+                metrics.duplicateFiles.add(duplicate.files.size());
+            }
+            ScopedNanos timer(metrics.outputNanos);
+            writer.complete(task, std::move(duplicates));
+        });
+    }
+    pool.wait();
+    stages.next(ScanStage::Finish);
+    if (scan.cache != nullptr) { // сохранение всех вычисленных хэшей для следующего запуска
+        for (size_t i = 0; i < files.size(); ++i) {
+            std::vector<uint32_t> hashes = files[i].computedHashes();
+            if (cacheKeys[i].blockSize != 0 && !hashes.empty() && !files[i].failed()) { // хэши измененного файла не соответствуют ключу
+                scan.cache->store(cacheKeys[i], hashes);
+            }
+        }
+    }
+    if (scan.snapshot != nullptr) { // метаданные, хэши и группы кандидатов для следующего снимка
+        std::vector<uint32_t> owners(candidates.size(), UINT32_MAX); // последовательность хэшей каждого кандидата
+        for (size_t i = 0; i < files.size(); ++i) {
+            for (uint32_t link = linkStarts[i]; link < linkStarts[i + 1]; ++link) {
+                owners[links[link]] = static_cast<uint32_t>(i);
+            }
+        }
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            if ((!changes.missing.empty() && changes.missing[i]) || (owners[i] != UINT32_MAX && files[owners[i]].failed())) { // удаленный или измененный файл заново проверит следующий поиск
+                scan.snapshot->remove(candidates.directory(i), candidates.name(i));
+            } else if (owners[i] == UINT32_MAX) {
+                scan.snapshot->update(candidates.directory(i), candidates.name(i), candidates.metadata(i), 0, {});
+            } else {
+                scan.snapshot->update(candidates.directory(i), candidates.name(i), candidates.metadata(i), groupIds[owners[i]], files[owners[i]].computedHashes());
+            }
+        }
+    }
+}
+
+} // namespace
+
+DuplicateFinder::DuplicateFinder(FinderConfig config) : config_(std::move(config)) {}
+
+DuplicateFinder::~DuplicateFinder() = default;
+
+void DuplicateFinder::run(ResultSink& sink) {
+    run([&sink](const DuplicateGroup& group) { sink.write(group); });
+}
+
+void DuplicateFinder::run(const GroupCallback& onGroup) {
+    const FinderConfig& settings = config_;
+    const size_t blockSize = settings.blockSize;
+    const fs::path& cachePath = settings.cachePath;
+    size_t threadCount = settings.threadCount;
+    if (blockSize == 0 || blockSize > UINT32_MAX) {
+        throw std::runtime_error("Invalid block size: " + std::to_string(blockSize));
+    }
+    GlobFilter maskFilter(settings.masks, settings.excludeMasks, settings.caseSensitive); // маски компилируются один раз
+    if (threadCount == 0) { // по умолчанию поток на каждое ядро процессора
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    ScanMetrics& metrics = metrics_; // счетчики ведутся всегда: обновление - одно атомарное сложение в ячейке своего потока
+    StageTimer stages(metrics, ScanStage::Walk);
+    const BlockHasher& hasher = hasher_ != nullptr ? *hasher_ : selectBlockHasher(settings.algorithm); // по умолчанию самая быстрая реализация алгоритма для этого процессора
+    std::unique_ptr<ScanSnapshot> snapshot = std::move(snapshot_); // снимок прошлого поиска и содержимое директорий для следующего
+    if (snapshot && snapshot->fingerprint() == snapshotFingerprint(settings, hasher)) { // снимок прошлого run этого объекта
+        snapshot->begin();
+    } else if (!settings.snapshotPath.empty() || settings.incremental) {
+        snapshot = std::make_unique<ScanSnapshot>(snapshotFingerprint(settings, hasher));
+        if (!settings.snapshotPath.empty()) {
+            snapshot->load(settings.snapshotPath);
+        }
+    }
+    applyIoPriority(settings.resources);
+    std::unique_ptr<CandidateSpill> spill; // nullptr - все кандидаты остаются в памяти
+    if (settings.resources.memoryBytes > 0 && !snapshot) { // снимку нужны все кандидаты сразу, с ним бюджет не действует
+        spill = std::make_unique<CandidateSpill>(settings.resources.spillDirectory);
+    }
+    FileTable candidates = collectCandidates(maskFilter, snapshot.get(), threadCount, spill.get()); // все файлы-кандидаты
+    stages.next(ScanStage::Group);
+    WorkerPool pool(threadCount, threadCount * 4);
+    SnapshotChanges changes; // пусто - снимка прошлого поиска нет, все группы ищутся заново
+    if (snapshot && snapshot->loaded()) {
+        metrics.directoriesReused.add(snapshot->reusedDirectories());
+        changes = findChanges(*snapshot, candidates, settings.minSize, pool);
+    }
+    IoScheduler scheduler(settings.deviceReads);
+    std::unique_ptr<ReadThrottle> throttle = createThrottle(settings.resources, metrics); // nullptr - скорость чтения не ограничена
+    HashCache cache; // хэши неизмененных файлов из прошлого запуска
+    if (!cachePath.empty()) {
+        cache.load(cachePath);
+    }
+    std::unique_ptr<AsyncReader> reader; // nullptr - первые блоки читаются рабочими потоками
+    if (settings.asyncIo && blockSize <= maxAsyncBlockBytes) {
+        reader = AsyncReader::create(asyncQueueDepth, asyncQueueDepth * 2, blockSize);
+    }
+    const ScanResources scan{settings, hasher, metrics, stages, pool, scheduler, reader.get(), throttle.get(), cachePath.empty() ? nullptr : &cache, snapshot.get(), threadCount};
+    if (spill && spill->runCount() > 0) { // кандидаты не поместились в бюджет: порции целых групп размеров по возрастанию размера
+        spill->forEachBatch(settings.resources.memoryBytes / 2, hashingBytesPerFile, [&](const FileTable& batch) { findGroups(batch, changes, onGroup, scan); });
+    } else {
+        findGroups(candidates, changes, onGroup, scan);
+    }
+    stages.next(ScanStage::Finish);
+    if (!cachePath.empty()) {
+        cache.save(cachePath);
+    }
+    if (snapshot) { // следующий снимок: содержимое директорий из обхода и кандидаты, добавленные findGroups
+        if (!settings.snapshotPath.empty()) {
+            snapshot->save(settings.snapshotPath);
+        }
+        if (settings.incremental) { // прерванный исключением поиск снимок не сохраняет, следующий run начнется с полного поиска
+            snapshot->advance();
+            snapshot_ = std::move(snapshot);
+        }
+    }
+}
+
+FileTable DuplicateFinder::collectCandidates(const GlobFilter& maskFilter, ListingStore* listings, size_t threadCount, CandidateSpill* spill) {
+    std::vector<fs::path> roots; // существующие и не исключенные корни обхода
+    std::vector<PathSet> rootExclusions; // исключенные поддеревья каждого корня
+    for (const auto& dir : config_.directories) { // перебор директорий
+        std::error_code error;
+        if (!fs::is_directory(fs::status(dir, error))) { // если директории не существует или не является директорий (один запрос к файловой системе)
+            std::cerr << "Directory doesn't exist or isn't a directory: " << dir << std::endl;
+            continue;
+        }
+        PathSet excluded = excludedDirectories(dir, config_.exclusions); // исключенные поддеревья этого корня
+        if (excluded.count(normalizedDirectory(dir))) { // корень сам исключен
+            continue;
+        }
+        roots.push_back(dir);
+        rootExclusions.push_back(std::move(excluded));
+        metrics_.directories.add(1);
+    }
+    // Параллельный обход: каждый поток собирает свою таблицу кандидатов, после обхода таблицы объединяются
+    std::shared_ptr<const FileWalker> walker = walker_;
+    if (!walker) { // обход по умолчанию берет из снимка директории, которые не изменились
+        auto directoryWalker = std::make_shared<DirectoryWalker>(threadCount);
+        directoryWalker->setListingStore(listings);
+        walker = std::move(directoryWalker);
+    }
+    std::vector<FileTable> workerCandidates(walker->threadCount());
+    // Доля бюджета таблицы потока; таблицы меньше minSpillBytes не записываются, иначе при малом бюджете серией становился бы каждый файл
+    const size_t spillBytes = spill != nullptr ? std::max(config_.resources.memoryBytes / 2 / std::max<size_t>(workerCandidates.size(), 1), minSpillBytes) : SIZE_MAX;
+    walker->walk(roots, config_.scanLevel,
+        [&rootExclusions, this](size_t rootIndex, const fs::path& directory) { // исключенное поддерево не обходится
+            const PathSet& excluded = rootExclusions[rootIndex];
+            bool skip = !excluded.empty() && excluded.count(normalizedDirectory(directory)) > 0;
+            metrics_.directories.add(skip ? 0 : 1);
+            return skip;
+        },
+        [&maskFilter, this](NativeName name) { // маски проверяются до запроса метаданных
+#if defined(_WIN32)
+            bool accepted = maskFilter.matches(fs::path(name).string()); // на Windows имя преобразуется из UTF-16
+#else
+            bool accepted = maskFilter.matches(name);
+#endif
+            metrics_.filesSeen.add(1);
+            metrics_.filesFiltered.add(accepted ? 0 : 1);
+            return accepted;
+        },
+        [this, &workerCandidates, spill, spillBytes](size_t worker, size_t, fs::path path, const FileMetadata& metadata) {
+            FileTable& table = workerCandidates[worker];
+            processFile(path, metadata, config_.minSize, table, metrics_); // обработка файла
+            if (table.memoryUsage() > spillBytes) { // таблица записывается во временный файл отсортированной серией
+                spill->write(table);
+                metrics_.candidatesSpilled.add(table.size());
+                table = FileTable();
+            }
+        });
+    FileTable candidates;
+    if (spill != nullptr && spill->runCount() > 0) { // часть кандидатов уже на диске: остальные тоже, порции соберет слияние серий
+        for (const auto& table : workerCandidates) {
+            spill->write(table);
+            metrics_.candidatesSpilled.add(table.size());
+        }
+        return candidates;
+    }
+    for (auto& table : workerCandidates) {
+        candidates.append(std::move(table));
+    }
+    if (candidates.size() > UINT32_MAX) {
+        throw std::runtime_error("Too many files to compare");
+    }
+    return candidates;
+}
+
+void DuplicateFinder::invalidate(const std::vector<fs::path>& directories) {
+    if (snapshot_) {
+        for (const auto& directory : directories) {
+            snapshot_->invalidate(directory);
+        }
+    }
+}
+
+std::vector<fs::path> DuplicateFinder::scannedDirectories() const {
+    return snapshot_ ? snapshot_->directories() : std::vector<fs::path>();
+}
+
+void DuplicateFinder::writeIndex(const fs::path& indexPath, const std::string& node, const std::vector<uint64_t>* sizes) {
+    const FinderConfig& settings = config_;
+    if (settings.blockSize == 0 || settings.blockSize > UINT32_MAX) {
+        throw std::runtime_error("Invalid block size: " + std::to_string(settings.blockSize));
+    }
+    size_t threadCount = settings.threadCount != 0 ? settings.threadCount : std::max(1u, std::thread::hardware_concurrency());
+    GlobFilter maskFilter(settings.masks, settings.excludeMasks, settings.caseSensitive);
+    StageTimer stages(metrics_, ScanStage::Walk);
+    const BlockHasher& hasher = hasher_ != nullptr ? *hasher_ : selectBlockHasher(settings.algorithm);
+    applyIoPriority(settings.resources);
+    FileTable candidates = collectCandidates(maskFilter, nullptr, threadCount);
+    stages.next(ScanStage::Group);
+    std::vector<uint32_t> order; // файлы индекса; жесткие ссылки на один inode оказываются рядом и хэшируются один раз
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (sizes == nullptr || std::binary_search(sizes->begin(), sizes->end(), candidates.fileSize(i))) {
+            order.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    std::sort(order.begin(), order.end(), [&candidates](uint32_t left, uint32_t right) {
+        return std::make_tuple(candidates.fileSize(left), candidates.device(left), candidates.inode(left), left) <
+               std::make_tuple(candidates.fileSize(right), candidates.device(right), candidates.inode(right), right);
+    });
+    metrics_.candidates.add(order.size());
+    std::vector<IndexEntry> entries(order.size());
+    for (size_t k = 0; k < order.size(); ++k) {
+        entries[k].size = candidates.fileSize(order[k]);
+        entries[k].device = candidates.device(order[k]);
+        entries[k].inode = candidates.inode(order[k]);
+        entries[k].path = candidates.path(order[k]).u8string();
+    }
+    if (sizes != nullptr) { // второй проход: размеры совпали на всех узлах, нужны хэши всех блоков
+        stages.next(ScanStage::Hash);
+        const BlockLayout layout(settings.strategy, settings.blockSize);
+        IoScheduler scheduler(settings.deviceReads);
+        std::unique_ptr<ReadThrottle> throttle = createThrottle(settings.resources, metrics_);
+        const HashingContext context{candidates, layout, hasher, &metrics_, &scheduler, settings.cacheMode, throttle.get()};
+        std::vector<char> skipped(entries.size(), 0); // файл не удалось прочитать
+        WorkerPool pool(threadCount, threadCount * 4);
+        for (size_t first = 0, last = 0; first < order.size(); first = last) {
+            for (last = first + 1; last < order.size() && entries[first].inode != 0 && entries[last].size == entries[first].size &&
+                                   entries[last].device == entries[first].device && entries[last].inode == entries[first].inode;) {
+                ++last;
+            }
+            pool.submit([&, first, last] {
+                LazyHashSequence file(context, order[first]);
+                uint32_t hash;
+                if (file.blockCount() > 0 && !file.tryHashAt(file.blockCount() - 1, hash)) {
+                    for (size_t k = first; k < last; ++k) {
+                        skipped[k] = 1;
+                    }
+                    return;
+                }
+                std::vector<uint32_t> hashes = file.computedHashes();
+                for (size_t k = first; k < last; ++k) {
+                    entries[k].hashes = hashes;
+                }
+            });
+        }
+        pool.wait();
+        // Файлы, удаленные или измененные после обхода, в индекс не попадают
+        size_t kept = 0;
+        for (size_t k = 0; k < entries.size(); ++k) {
+            if (skipped[k]) {
+                continue;
+            }
+            if (kept != k) { // перемещение записи в саму себя очистило бы ее путь и хэши
+                entries[kept] = std::move(entries[k]);
+            }
+            ++kept;
+        }
+        entries.resize(kept);
+    }
+    stages.next(ScanStage::Finish);
+    std::sort(entries.begin(), entries.end(), indexEntryLess);
+    std::ostringstream layoutName; // хэши сравнимы только при одинаковом разбиении на блоки и одной хэш-функции
+    layoutName << "blockSize=" << settings.blockSize << " strategy=" << blockStrategyName(settings.strategy) << " hash=" << hashAlgorithmName(hasher.algorithm);
+    PartialIndexWriter writer(indexPath, {node, layoutName.str(), sizes != nullptr});
+    for (const auto& entry : entries) {
+        writer.write(entry);
+    }
+    writer.finish();
+}
+
+ChunkSummary DuplicateFinder::findSimilar(double minShare, const ChunkingParams& chunking, const std::function<void(const SimilarFiles& pair)>& onPair) {
+    const FinderConfig& settings = config_;
+    size_t threadCount = settings.threadCount != 0 ? settings.threadCount : std::max(1u, std::thread::hardware_concurrency());
+    const ContentChunker chunker(chunking);
+    GlobFilter maskFilter(settings.masks, settings.excludeMasks, settings.caseSensitive);
+    StageTimer stages(metrics_, ScanStage::Walk);
+    applyIoPriority(settings.resources);
+    FileTable candidates = collectCandidates(maskFilter, nullptr, threadCount);
+    stages.next(ScanStage::Group);
+    std::vector<uint32_t> order(candidates.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    std::sort(order.begin(), order.end(), [&candidates](uint32_t left, uint32_t right) {
+        return std::make_tuple(candidates.device(left), candidates.inode(left), left) < std::make_tuple(candidates.device(right), candidates.inode(right), right);
+    });
+    std::vector<uint32_t> files; // по одному пути на inode (наименьшему): жесткие ссылки не занимают места повторно
+    for (size_t k = 0; k < order.size(); ++k) {
+        if (k == 0 || candidates.inode(order[k]) == 0 || candidates.inode(order[k]) != candidates.inode(order[k - 1]) ||
+            candidates.device(order[k]) != candidates.device(order[k - 1])) {
+            files.push_back(order[k]);
+        } else if (candidates.path(order[k]) < candidates.path(files.back())) {
+            files.back() = order[k];
+        }
+    }
+    metrics_.candidates.add(files.size());
+    stages.next(ScanStage::Hash);
+    ChunkIndex index;
+    IoScheduler scheduler(settings.deviceReads);
+    std::unique_ptr<ReadThrottle> throttle = createThrottle(settings.resources, metrics_);
+    {
+        WorkerPool pool(threadCount, threadCount * 4);
+        for (size_t k = 0; k < files.size(); ++k) { // файлы упорядочены по устройству и inode
+            pool.submit([&, k] {
+                std::vector<Chunk> chunks;
+                try {
+                    IoScheduler::Permit permit = scheduler.acquire(candidates.device(files[k]));
+                    chunks = chunker.chunkFile(candidates.path(files[k]), throttle.get());
+                } catch (const std::runtime_error& error) { // файл удален после обхода: поиск продолжается без него
+                    std::cerr << std::string(error.what()) + ", skipping the file\n";
+                    return;
+                }
+                uint64_t bytes = 0;
+                for (const auto& chunk : chunks) {
+                    bytes += chunk.length;
+                }
+                metrics_.filesHashed.add(1);
+                metrics_.blocksHashed.add(chunks.size());
+                metrics_.bytesRead.add(bytes);
+                index.add(static_cast<uint32_t>(k), std::move(chunks));
+            });
+        }
+        pool.wait();
+    }
+    stages.next(ScanStage::Compare);
+    index.finish();
+    std::vector<SimilarFiles> pairs;
+    index.forEachPair(maxSharedFiles, [&](uint32_t first, uint32_t second, uint64_t sharedBytes) {
+        uint32_t larger = files[first];
+        uint32_t smaller = files[second];
+        if (std::make_tuple(candidates.fileSize(smaller), candidates.path(larger)) > std::make_tuple(candidates.fileSize(larger), candidates.path(smaller))) {
+            std::swap(larger, smaller);
+        }
+        if (sharedBytes >= minShare * static_cast<double>(candidates.fileSize(larger))) {
+            pairs.push_back({candidates.path(larger), candidates.path(smaller), candidates.fileSize(larger), candidates.fileSize(smaller), sharedBytes});
+        }
+    });
+    std::sort(pairs.begin(), pairs.end(), [](const SimilarFiles& left, const SimilarFiles& right) { // по убыванию доли общих участков
+        double leftShare = static_cast<double>(left.sharedBytes) / static_cast<double>(std::max<uintmax_t>(left.firstSize, 1));
+        double rightShare = static_cast<double>(right.sharedBytes) / static_cast<double>(std::max<uintmax_t>(right.firstSize, 1));
+        return std::tie(rightShare, left.first, left.second) < std::tie(leftShare, right.first, right.second);
+    });
+    stages.next(ScanStage::Finish);
+    metrics_.groups.add(pairs.size());
+    for (const auto& pair : pairs) {
+        onPair(pair);
+    }
+    return index.summary();
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "block_hash.h"
+#include "block_layout.h"
+#include "chunk_index.h"
+#include "content_verifier.h"
+#include "directory_walker.h"
+#include "file_reader.h"
+#include "io_scheduler.h"
+#include "resource_governor.h"
+#include "result_sink.h"
+#include "scan_metrics.h"
+
+class CandidateSpill;
+class FileTable;
+class GlobFilter;
+class ScanSnapshot;
+
+// Параметры поиска дубликатов
+struct FinderConfig {
+    std::vector<std::filesystem::path> directories; // вектор с путями до директорий
+    std::vector<std::filesystem::path> exclusions; // вектор с путями исключенных директорий
+    int scanLevel = -1; // глубина сканирования (0 - без вложенных директорий, N - до N уровней вложенности, -1 - без ограничения)
+    std::vector<std::string> masks{"*"}; // маски имен файлов, которые нужно сравнивать
+    std::vector<std::string> excludeMasks; // маски имен файлов, которые нужно пропускать
+    bool caseSensitive = false; // учитывать регистр в масках
+    size_t blockSize = 4096; // размер блока (для адаптивной стратегии - начального и конечного блоков)
+    BlockStrategy strategy = BlockStrategy::Adaptive; // стратегия разбиения файлов на блоки
+    size_t minSize = 1; // минимальный размер файла
+    HashAlgorithm algorithm = HashAlgorithm::CRC32; // алгоритм хэширования блоков
+    size_t threadCount = 0; // количество потоков хэширования (0 - по количеству ядер процессора)
+    std::filesystem::path cachePath; // файл постоянного кэша хэшей (пустой путь - кэш не используется)
+    VerifyMode verify = VerifyMode::None; // окончательная проверка найденных групп
+    bool asyncIo = true; // читать первые блоки через io_uring, если ядро его поддерживает
+    DeviceLimits deviceReads; // наибольшее количество одновременных чтений с одного устройства
+    CacheMode cacheMode = CacheMode::Keep; // влияние чтения файлов на страничный кэш ОС
+    std::filesystem::path snapshotPath; // снимок прошлого поиска для инкрементального повторного поиска (пустой путь - не используется)
+    bool incremental = false; // хранить снимок в памяти между вызовами run (для режима наблюдения за изменениями)
+    // Бюджет памяти, скорость чтения и приоритет ввода-вывода. Бюджет действует в run без снимка: таблицы потоков обхода, превысившие
+    // свою долю половины бюджета, записываются во временные файлы, и группы ищутся порциями размеров. idleIo меняет приоритет
+    // вызывающего потока до конца его работы
+    ResourceLimits resources;
+};
+
+// Движок поиска дубликатов: обход директорий, группировка по размеру, сравнение хэшей блоков и проверка групп.
+// Обход и хэш-функцию можно заменить, результаты передаются получателю по мере подтверждения групп
+class DuplicateFinder {
+public:
+    explicit DuplicateFinder(FinderConfig config);
+    ~DuplicateFinder();
+
+    const FinderConfig& config() const { return config_; }
+    // Счетчики и время этапов; их можно читать из другого потока во время поиска, повторный поиск их накапливает
+    const ScanMetrics& metrics() const { return metrics_; }
+
+    // Замена обхода директорий (по умолчанию DirectoryWalker с config.threadCount потоками)
+    void setWalker(std::shared_ptr<const FileWalker> walker) { walker_ = std::move(walker); }
+    // Замена хэш-функции блоков (по умолчанию самая быстрая реализация config.algorithm); hasher.algorithm входит в ключ кэша
+    void setHasher(const BlockHasher& hasher) { hasher_ = &hasher; }
+
+    // Поиск дубликатов: группы передаются в onGroup по одной, по возрастанию размера файлов и в порядке, не зависящем от потоков.
+    // onGroup вызывается из рабочих потоков, но никогда одновременно; исключение из onGroup прерывает поиск
+    void run(const GroupCallback& onGroup);
+    // Поиск дубликатов с выводом групп в sink (sink.finish вызывает владелец получателя)
+    void run(ResultSink& sink);
+
+    // Директории, изменение которых известно (например, из уведомлений файловой системы): следующий run с config.incremental
+    // читает их заново и перепроверяет их файлы, остальное берется из снимка прошлого run
+    void invalidate(const std::vector<std::filesystem::path>& directories);
+    // Директории, обойденные прошлым run с config.incremental (пути с завершающим разделителем)
+    std::vector<std::filesystem::path> scannedDirectories() const;
+
+    // Частичный индекс этого узла для распределенного поиска (см. partial_index.h). Без sizes - индекс размеров всех кандидатов
+    // (файлы не читаются), с sizes (отсортированные размеры из слияния индексов размеров) - индекс хэшей всех блоков файлов этих размеров
+    void writeIndex(const std::filesystem::path& indexPath, const std::string& node, const std::vector<uint64_t>* sizes);
+
+    // Поиск частичных дубликатов по участкам переменной длины (см. content_chunker.h): кандидаты читаются целиком, пары файлов,
+    // общие участки которых составляют не меньше minShare размера большего файла, передаются в onPair по убыванию доли.
+    // Возвращает оценку экономии при хранении каждого различного участка один раз
+    ChunkSummary findSimilar(double minShare, const ChunkingParams& chunking, const std::function<void(const SimilarFiles& pair)>& onPair);
+
+private:
+    // Обход директорий config.directories: все файлы-кандидаты; listings - хранилище содержимого директорий для обхода по умолчанию.
+    // С spill таблицы, превысившие бюджет памяти, записываются в spill; если записана хотя бы одна, туда же уходят все кандидаты
+    FileTable collectCandidates(const GlobFilter& maskFilter, ListingStore* listings, size_t threadCount, CandidateSpill* spill = nullptr);
+
+    FinderConfig config_;
+    std::shared_ptr<const FileWalker> walker_; // nullptr - DirectoryWalker по умолчанию
+    const BlockHasher* hasher_ = nullptr; // nullptr - selectBlockHasher(config.algorithm)
+    ScanMetrics metrics_;
+    std::unique_ptr<ScanSnapshot> snapshot_; // снимок прошлого run (config.incremental)
+};
@@ -0,0 +1,622 @@
+#include "file_reader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "buffer_pool.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <csetjmp>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t mapWindowBytes = 64 * 1024 * 1024; // размер окна отображения: большие файлы отображаются и освобождаются по частям
+
+#if !defined(_WIN32)
+thread_local sigjmp_buf* mappedAccessJump = nullptr; // точка возврата текущего обращения потока к отображению (nullptr - обращения нет)
+struct sigaction previousBusAction; // обработчик SIGBUS, установленный до нашего
+
+// Обработчик SIGBUS: обращение к странице за концом укороченного файла прерывает защищенное обращение, остальные сигналы
+// передаются прежнему обработчику (по умолчанию - завершение процесса)
+void handleBusError(int signal, siginfo_t* info, void* context) {
+    if (mappedAccessJump != nullptr) {
+        siglongjmp(*mappedAccessJump, 1);
+    }
+    if ((previousBusAction.sa_flags & SA_SIGINFO) != 0) {
+        previousBusAction.sa_sigaction(signal, info, context);
+    } else if (previousBusAction.sa_handler != SIG_DFL && previousBusAction.sa_handler != SIG_IGN) {
+        previousBusAction.sa_handler(signal);
+    } else {
+        ::signal(SIGBUS, SIG_DFL);
+        ::raise(SIGBUS);
+    }
+}
+
+// Функция для установки обработчика SIGBUS (один раз на процесс)
+void installBusHandler() {
+    static const bool installed = [] {
+        struct sigaction action {};
+        action.sa_sigaction = handleBusError;
+        action.sa_flags = SA_SIGINFO | SA_NODEFER; // сигнал не блокируется в обработчике: выход через siglongjmp не восстанавливает маску
+        sigemptyset(&action.sa_mask);
+        return ::sigaction(SIGBUS, &action, &previousBusAction) == 0;
+    }();
+    (void)installed;
+}
+
+// Блоки отображенного участка, которые хэшируются под защитой от SIGBUS: память выделена до обращения к страницам
+struct MappedBlocks {
+    const unsigned char* data;
+    size_t size;
+    size_t blockSize;
+    BlockHashFunction hash;
+    uint32_t* hashes; // место для хэшей всех блоков участка
+    unsigned char* lastBlock; // буфер неполного последнего блока (nullptr - участок из целых блоков)
+    volatile size_t done; // вычисленные хэши (читается после прерывания)
+};
+
+void hashBlocks(void* context) {
+    MappedBlocks& blocks = *static_cast<MappedBlocks*>(context);
+    const size_t blockSize = blocks.blockSize;
+    for (size_t done = 0; (done + 1) * blockSize <= blocks.size; blocks.done = ++done) {
+        blocks.hashes[done] = blocks.hash(blocks.data + done * blockSize, blockSize);
+    }
+    if (blocks.lastBlock != nullptr) {
+        const size_t done = blocks.done;
+        const size_t tail = blocks.size - done * blockSize;
+        std::memcpy(blocks.lastBlock, blocks.data + done * blockSize, tail);
+        std::memset(blocks.lastBlock + tail, 0, blockSize - tail);
+        blocks.hashes[done] = blocks.hash(blocks.lastBlock, blockSize);
+        blocks.done = done + 1;
+    }
+}
+
+// Хэширование блоков отображенного участка; неполный последний блок копируется в буфер с нулями.
+// Возвращает false, если файл укоротили во время чтения (в hashSequence остаются хэши блоков до недоступной страницы)
+bool hashMappedView(const unsigned char* data, size_t size, size_t blockSize, const BlockHasher& hasher, std::vector<uint32_t>& hashSequence) {
+    const size_t start = hashSequence.size();
+    hashSequence.resize(start + (size + blockSize - 1) / blockSize);
+    std::optional<PooledBuffer> lastBlock;
+    if (size % blockSize != 0) {
+        lastBlock.emplace(blockSize);
+    }
+    MappedBlocks blocks{data, size, blockSize, hasher.forSize(blockSize), hashSequence.data() + start, lastBlock ? lastBlock->data() : nullptr, 0};
+    const bool complete = accessMappedPages(hashBlocks, &blocks);
+    hashSequence.resize(start + blocks.done);
+    return complete;
+}
+#endif
+
+// Хэширование блоков из непрерывного участка памяти; неполный последний блок копируется в буфер с нулями
+void hashMappedBlocks(const unsigned char* data, size_t size, size_t blockSize, const BlockHasher& hasher, std::vector<uint32_t>& hashSequence) {
+    const BlockHashFunction hash = hasher.forSize(blockSize); // для 4 КиБ, 64 КиБ и 1 МиБ - ядро с длиной-константой
+    while (size >= blockSize) {
+        hashSequence.push_back(hash(data, blockSize));
+        data += blockSize;
+        size -= blockSize;
+    }
+    if (size > 0) {
+        PooledBuffer lastBlock(blockSize);
+        std::memcpy(lastBlock.data(), data, size);
+        std::memset(lastBlock.data() + size, 0, blockSize - size);
+        hashSequence.push_back(hash(lastBlock.data(), blockSize));
+    }
+}
+
+#if defined(_WIN32)
+// Дескриптор Windows, закрываемый автоматически
+struct HandleGuard {
+    HANDLE handle;
+    ~HandleGuard() {
+        if (handle != nullptr && handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+    }
+};
+
+// Чтение через MapViewOfFile; возвращает false, если файл нельзя отобразить в память
+bool readFileMapped(NativePath filePath, size_t blockSize, const BlockHasher& hasher, size_t firstBlock, size_t maxBlocks, CacheMode cacheMode,
+                    std::vector<uint32_t>& hashSequence) {
+    (void)cacheMode; // кэш Windows отдает страницы отображения без подсказок, режимы Drop и Direct на Windows не действуют
+    HandleGuard file{CreateFileW(filePath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr)};
+    if (file.handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot open file: " + fs::path(filePath).string());
+    }
+    LARGE_INTEGER fileSize;
+    if (GetFileType(file.handle) != FILE_TYPE_DISK || !GetFileSizeEx(file.handle, &fileSize) || fileSize.QuadPart == 0) {
+        return false;
+    }
+    HandleGuard mapping{CreateFileMappingW(file.handle, nullptr, PAGE_READONLY, 0, 0, nullptr)};
+    if (mapping.handle == nullptr) {
+        return false;
+    }
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    const uint64_t granularity = systemInfo.dwAllocationGranularity; // смещение отображения должно быть кратно гранулярности
+    const uint64_t size = static_cast<uint64_t>(fileSize.QuadPart);
+    const uint64_t window = std::max<uint64_t>(blockSize, mapWindowBytes / blockSize * blockSize);
+    const size_t start = hashSequence.size(); // хэши, полученные до вызова
+    uint64_t offset = static_cast<uint64_t>(firstBlock) * blockSize;
+    while (hashSequence.size() - start < maxBlocks && offset < size) {
+        uint64_t length = std::min<uint64_t>({window, size - offset, static_cast<uint64_t>(maxBlocks - (hashSequence.size() - start)) * blockSize});
+        uint64_t mapOffset = offset / granularity * granularity;
+        size_t delta = static_cast<size_t>(offset - mapOffset);
+        void* view = MapViewOfFile(mapping.handle, FILE_MAP_READ, static_cast<DWORD>(mapOffset >> 32), static_cast<DWORD>(mapOffset), static_cast<SIZE_T>(length + delta));
+        if (view == nullptr) {
+            return false;
+        }
+        hashMappedBlocks(static_cast<const unsigned char*>(view) + delta, static_cast<size_t>(length), blockSize, hasher, hashSequence);
+        UnmapViewOfFile(view);
+        offset += length;
+    }
+    return true;
+}
+
+// Хэширование участков через MapViewOfFile; возвращает false, если файл нельзя отобразить в память
+bool readRangesMapped(NativePath filePath, const std::vector<FileRange>& ranges, const BlockHasher& hasher, CacheMode cacheMode, size_t start, std::vector<uint32_t>& hashes) {
+    (void)cacheMode;
+    HandleGuard file{CreateFileW(filePath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr)};
+    if (file.handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot open file: " + fs::path(filePath).string());
+    }
+    LARGE_INTEGER fileSize;
+    if (GetFileType(file.handle) != FILE_TYPE_DISK || !GetFileSizeEx(file.handle, &fileSize) || fileSize.QuadPart == 0) {
+        return false;
+    }
+    HandleGuard mapping{CreateFileMappingW(file.handle, nullptr, PAGE_READONLY, 0, 0, nullptr)};
+    if (mapping.handle == nullptr) {
+        return false;
+    }
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    const uint64_t granularity = systemInfo.dwAllocationGranularity;
+    const uint64_t size = static_cast<uint64_t>(fileSize.QuadPart);
+    for (size_t i = hashes.size() - start; i < ranges.size() && ranges[i].offset + ranges[i].length <= size; ++i) {
+        uint64_t mapOffset = ranges[i].offset / granularity * granularity;
+        size_t delta = static_cast<size_t>(ranges[i].offset - mapOffset);
+        void* view = MapViewOfFile(mapping.handle, FILE_MAP_READ, static_cast<DWORD>(mapOffset >> 32), static_cast<DWORD>(mapOffset), static_cast<SIZE_T>(ranges[i].length + delta));
+        if (view == nullptr) {
+            return false;
+        }
+        hashes.push_back(hasher.forSize(static_cast<size_t>(ranges[i].length))(static_cast<const unsigned char*>(view) + delta, static_cast<size_t>(ranges[i].length)));
+        UnmapViewOfFile(view);
+    }
+    return true;
+}
+#else
+constexpr size_t directAlignment = 4096; // выравнивание смещений, длин и буферов O_DIRECT (не меньше логического блока устройств)
+constexpr size_t directWindowBytes = 4 * 1024 * 1024; // буфер чтения O_DIRECT
+
+// Файловый дескриптор, закрываемый автоматически
+struct FileDescriptor {
+    int fd;
+    ~FileDescriptor() {
+        if (fd >= 0) ::close(fd);
+    }
+};
+
+// Страницы отображения, которые были в кэше до чтения (режим Drop): после хэширования вытесняются только остальные,
+// так что файлы, которые читают другие программы, остаются в кэше
+class ReadFootprint {
+public:
+    ReadFootprint(CacheMode cacheMode, int fd) : enabled_(cacheMode != CacheMode::Keep), fd_(fd), resident_(residentPages()) {}
+
+    // Запоминание кэшированных страниц отображения view длиной length со смещением offset в файле (до обращения к данным).
+    // Упреждающее чтение за пределы отображения выключается: иначе при следующем отображении прочитанные заранее страницы
+    // выглядели бы кэшированными до чтения и оставались в кэше. Вместо него отображение целиком запрашивается заранее
+    void record(void* view, size_t length, uint64_t offset) {
+#if defined(__linux__)
+        if (!enabled_) {
+            return;
+        }
+        static const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        offset_ = offset;
+        resident_.resize((length + pageSize - 1) / pageSize); // после первых файлов емкости вектора хватает
+        if (::mincore(view, length, resident_.data()) != 0) { // сведений нет: ничего не вытесняется
+            resident_.assign(resident_.size(), 1);
+        }
+        ::madvise(view, length, MADV_RANDOM);
+        ::madvise(view, length, MADV_WILLNEED);
+#else
+        (void)view;
+        (void)length;
+        (void)offset;
+#endif
+    }
+
+    // Вытеснение из кэша прочитанных страниц, которых в нем не было (после munmap)
+    void drop() {
+#if defined(__linux__)
+        static const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        for (size_t page = 0, end = 0; enabled_ && page < resident_.size(); page = end) {
+            for (end = page + 1; end < resident_.size() && (resident_[end] & 1) == (resident_[page] & 1);) {
+                ++end;
+            }
+            if ((resident_[page] & 1) == 0) {
+                ::posix_fadvise(fd_, static_cast<off_t>(offset_ + page * pageSize), static_cast<off_t>((end - page) * pageSize), POSIX_FADV_DONTNEED);
+            }
+        }
+        resident_.clear();
+#endif
+    }
+
+private:
+    bool enabled_;
+    int fd_;
+    uint64_t offset_ = 0;
+    std::vector<unsigned char>& resident_; // младший бит - страница была в кэше (общий вектор потока)
+
+    static std::vector<unsigned char>& residentPages() {
+        thread_local std::vector<unsigned char> pages;
+        return pages;
+    }
+};
+
+#if defined(__linux__)
+// Функция для чтения участка [offset, offset + length) файла, открытого с O_DIRECT: читается охватывающий выровненный участок
+// (buffer не меньше length + 2 * directAlignment байтов). Возвращает начало данных участка в buffer, в size - количество прочитанных
+// байтов участка (меньше length у конца файла или при ошибке); nullptr - файловая система не принимает чтения O_DIRECT
+const unsigned char* readDirect(int fd, uint64_t offset, size_t length, const PooledBuffer& pooled, size_t& size) {
+    const uint64_t alignedOffset = offset / directAlignment * directAlignment;
+    const size_t delta = static_cast<size_t>(offset - alignedOffset);
+    const size_t alignedLength = (delta + length + directAlignment - 1) / directAlignment * directAlignment;
+    unsigned char* buffer = pooled.data();
+    size_t done = 0;
+    while (done < delta + length) {
+        ssize_t result = ::pread(fd, buffer + done, alignedLength - done, static_cast<off_t>(alignedOffset + done));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0 && errno == EINVAL && done == 0) {
+            return nullptr;
+        }
+        if (result <= 0) { // конец файла или ошибка чтения: как и у потока, хэшируется прочитанное
+            break;
+        }
+        done += static_cast<size_t>(result);
+    }
+    size = done > delta ? std::min(done - delta, length) : 0;
+    return buffer + delta;
+}
+
+// Функция для открытия обычного файла с O_DIRECT; -1 - файл нужно читать другим способом (файловая система без O_DIRECT, специальный файл)
+int openDirect(NativePath filePath, uint64_t& size) {
+    int fd = ::open(filePath, O_RDONLY | O_CLOEXEC | O_DIRECT);
+    if (fd < 0) {
+        if (errno == EINVAL) {
+            return -1;
+        }
+        throw std::runtime_error("Cannot open file: " + fs::path(filePath).string());
+    }
+    struct stat status;
+    if (::fstat(fd, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size == 0) {
+        ::close(fd);
+        return -1;
+    }
+    size = static_cast<uint64_t>(status.st_size);
+    return fd;
+}
+
+// Чтение в обход кэша; возвращает false, если O_DIRECT недоступен (блоки, прочитанные до этого, остаются в hashSequence)
+bool readFileDirect(NativePath filePath, size_t blockSize, const BlockHasher& hasher, size_t firstBlock, size_t maxBlocks, std::vector<uint32_t>& hashSequence) {
+    uint64_t size = 0;
+    FileDescriptor file{openDirect(filePath, size)};
+    if (file.fd < 0) {
+        return false;
+    }
+    // Окно вместе с выровненными краями укладывается в буфер размера directWindowBytes
+    const uint64_t window = std::max<uint64_t>(blockSize, (directWindowBytes - 2 * directAlignment) / blockSize * blockSize);
+    PooledBuffer buffer(static_cast<size_t>(std::min<uint64_t>(window, size)) + 2 * directAlignment);
+    const size_t start = hashSequence.size();
+    uint64_t offset = static_cast<uint64_t>(firstBlock) * blockSize;
+    while (hashSequence.size() - start < maxBlocks && offset < size) {
+        uint64_t length = std::min<uint64_t>({window, size - offset, static_cast<uint64_t>(maxBlocks - (hashSequence.size() - start)) * blockSize});
+        size_t bytesRead = 0;
+        const unsigned char* data = readDirect(file.fd, offset, static_cast<size_t>(length), buffer, bytesRead);
+        if (data == nullptr) {
+            return false;
+        }
+        hashMappedBlocks(data, bytesRead, blockSize, hasher, hashSequence);
+        if (bytesRead < length) { // файл стал короче с момента fstat
+            break;
+        }
+        offset += length;
+    }
+    return true;
+}
+
+// Хэширование участков в обход кэша; возвращает false, если O_DIRECT недоступен
+bool readRangesDirect(NativePath filePath, const std::vector<FileRange>& ranges, const BlockHasher& hasher, size_t start, std::vector<uint32_t>& hashes) {
+    uint64_t size = 0;
+    FileDescriptor file{openDirect(filePath, size)};
+    if (file.fd < 0) {
+        return false;
+    }
+    uint64_t longest = 0;
+    for (const auto& range : ranges) {
+        longest = std::max(longest, range.length);
+    }
+    PooledBuffer buffer(static_cast<size_t>(longest) + 2 * directAlignment); // охватывающий выровненный участок длиннее на края
+    for (size_t i = hashes.size() - start; i < ranges.size(); ++i) {
+        size_t bytesRead = 0;
+        const unsigned char* data = readDirect(file.fd, ranges[i].offset, static_cast<size_t>(ranges[i].length), buffer, bytesRead);
+        if (data == nullptr) {
+            return false;
+        }
+        if (bytesRead < ranges[i].length) { // файл короче участка
+            break;
+        }
+        hashes.push_back(hasher.forSize(bytesRead)(data, bytesRead));
+    }
+    return true;
+}
+#endif
+
+// Чтение через mmap; возвращает false, если файл нельзя отобразить в память
+bool readFileMapped(NativePath filePath, size_t blockSize, const BlockHasher& hasher, size_t firstBlock, size_t maxBlocks, CacheMode cacheMode,
+                    std::vector<uint32_t>& hashSequence) {
+    FileDescriptor file{::open(filePath, O_RDONLY | O_CLOEXEC)};
+    if (file.fd < 0) {
+        throw std::runtime_error("Cannot open file: " + fs::path(filePath).string());
+    }
+    struct stat status;
+    if (::fstat(file.fd, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size == 0) { // специальные файлы читаются потоком
+        return false;
+    }
+    static const uint64_t pageSize = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE)); // смещение отображения должно быть кратно размеру страницы
+    ReadFootprint footprint(cacheMode, file.fd);
+    const uint64_t size = static_cast<uint64_t>(status.st_size);
+    const uint64_t window = std::max<uint64_t>(blockSize, mapWindowBytes / blockSize * blockSize);
+    const size_t start = hashSequence.size(); // хэши, полученные до вызова
+    uint64_t offset = static_cast<uint64_t>(firstBlock) * blockSize;
+    while (hashSequence.size() - start < maxBlocks && offset < size) {
+        uint64_t length = std::min<uint64_t>({window, size - offset, static_cast<uint64_t>(maxBlocks - (hashSequence.size() - start)) * blockSize});
+        uint64_t mapOffset = offset / pageSize * pageSize;
+        size_t delta = static_cast<size_t>(offset - mapOffset);
+        void* view = ::mmap(nullptr, static_cast<size_t>(length) + delta, PROT_READ, MAP_PRIVATE, file.fd, static_cast<off_t>(mapOffset));
+        if (view == MAP_FAILED) { // файловая система не поддерживает отображение
+            return false;
+        }
+        ::madvise(view, static_cast<size_t>(length) + delta, MADV_SEQUENTIAL);
+        footprint.record(view, static_cast<size_t>(length) + delta, mapOffset);
+        const bool complete = hashMappedView(static_cast<const unsigned char*>(view) + delta, static_cast<size_t>(length), blockSize, hasher, hashSequence);
+        ::munmap(view, static_cast<size_t>(length) + delta);
+        footprint.drop();
+        if (!complete) { // файл укоротили после fstat: потоком он прочитался бы не целиком
+            throw std::runtime_error("File changed during scan: " + fs::path(filePath).string());
+        }
+        offset += length;
+    }
+    return true;
+}
+
+// Хэширование участков через mmap; возвращает false, если файл нельзя отобразить в память
+bool readRangesMapped(NativePath filePath, const std::vector<FileRange>& ranges, const BlockHasher& hasher, CacheMode cacheMode, size_t start, std::vector<uint32_t>& hashes) {
+    FileDescriptor file{::open(filePath, O_RDONLY | O_CLOEXEC)};
+    if (file.fd < 0) {
+        throw std::runtime_error("Cannot open file: " + fs::path(filePath).string());
+    }
+    struct stat status;
+    if (::fstat(file.fd, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size == 0) {
+        return false;
+    }
+    static const uint64_t pageSize = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+    ReadFootprint footprint(cacheMode, file.fd);
+    const uint64_t size = static_cast<uint64_t>(status.st_size);
+    for (size_t i = hashes.size() - start; i < ranges.size() && ranges[i].offset + ranges[i].length <= size; ++i) {
+        uint64_t mapOffset = ranges[i].offset / pageSize * pageSize;
+        size_t delta = static_cast<size_t>(ranges[i].offset - mapOffset);
+        size_t length = static_cast<size_t>(ranges[i].length) + delta;
+        void* view = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file.fd, static_cast<off_t>(mapOffset));
+        if (view == MAP_FAILED) {
+            return false;
+        }
+        footprint.record(view, length, mapOffset);
+        ::madvise(view, length, MADV_WILLNEED); // участок нужен целиком
+        const bool complete = hashMappedView(static_cast<const unsigned char*>(view) + delta, static_cast<size_t>(ranges[i].length), static_cast<size_t>(ranges[i].length), hasher, hashes);
+        ::munmap(view, length);
+        footprint.drop();
+        if (!complete) {
+            throw std::runtime_error("File changed during scan: " + fs::path(filePath).string());
+        }
+    }
+    return true;
+}
+#endif
+
+// Чтение через буферизованный поток (для специальных файлов и файловых систем без поддержки отображения)
+void readFileBuffered(NativePath filePath, size_t blockSize, const BlockHasher& hasher, size_t firstBlock, size_t maxBlocks, std::vector<uint32_t>& hashSequence) {
+    std::ifstream file(fs::path(filePath), std::ios::binary); // открытие файла в бинарном режиме
+    if (!file) { // если файл не открывается
+        throw std::runtime_error("Cannot open file: " + fs::path(filePath).string());
+    }
+    if (firstBlock > 0) { // переход к первому нужному блоку
+        file.seekg(static_cast<std::streamoff>(firstBlock) * static_cast<std::streamoff>(blockSize));
+    }
+    PooledBuffer buffer(blockSize); // буфер для чтения блоков
+    char* data = reinterpret_cast<char*>(buffer.data());
+    const BlockHashFunction hashBlock = hasher.forSize(blockSize);
+    const size_t start = hashSequence.size(); // хэши, полученные до вызова
+    while (hashSequence.size() - start < maxBlocks && (file.read(data, static_cast<std::streamsize>(blockSize)) || file.gcount() > 0)) { // чтение данных из файла блоками
+        size_t bytesRead = static_cast<size_t>(file.gcount()); // количество прочитанных байтов
+        if (bytesRead < blockSize) { // если прочитано меньше байтов, чем размер блока
+            std::memset(data + bytesRead, 0, blockSize - bytesRead); // дополнение буфера нулями до полного размера блока
+        }
+        uint32_t hash = hashBlock(buffer.data(), blockSize); // вычисление хэша блока
+        hashSequence.push_back(hash); // добавление хэша в вектор хэшей
+    }
+}
+
+// Хэширование участков через буферизованный поток
+void readRangesBuffered(NativePath filePath, const std::vector<FileRange>& ranges, const BlockHasher& hasher, size_t start, std::vector<uint32_t>& hashes) {
+    std::ifstream file(fs::path(filePath), std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open file: " + fs::path(filePath).string());
+    }
+    uint64_t longest = 0;
+    for (const auto& range : ranges) {
+        longest = std::max(longest, range.length);
+    }
+    PooledBuffer buffer(static_cast<size_t>(longest));
+    for (size_t i = hashes.size() - start; i < ranges.size(); ++i) {
+        file.seekg(static_cast<std::streamoff>(ranges[i].offset));
+        if (!file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(ranges[i].length))) { // файл короче участка
+            return;
+        }
+        hashes.push_back(hasher.forSize(static_cast<size_t>(ranges[i].length))(buffer.data(), static_cast<size_t>(ranges[i].length)));
+    }
+}
+
+} // namespace
+
+bool parseCacheMode(const std::string& name, CacheMode& mode) {
+    if (name == "keep") {
+        mode = CacheMode::Keep;
+    } else if (name == "drop") {
+        mode = CacheMode::Drop;
+    } else if (name == "direct") {
+        mode = CacheMode::Direct;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* cacheModeName(CacheMode mode) {
+    switch (mode) {
+    case CacheMode::Drop:
+        return "drop";
+    case CacheMode::Direct:
+        return "direct";
+    default:
+        return "keep";
+    }
+}
+
+void readFile(NativePath filePath, size_t blockSize, const BlockHasher& hasher, std::vector<uint32_t>& hashes, size_t firstBlock, size_t maxBlocks, CacheMode cacheMode) {
+    const size_t start = hashes.size(); // хэши, полученные до вызова
+#if defined(__linux__)
+    if (cacheMode == CacheMode::Direct && readFileDirect(filePath, blockSize, hasher, firstBlock, maxBlocks, hashes)) {
+        return;
+    }
+#endif
+    // Без O_DIRECT оставшиеся блоки хэшируются из отображения, а если и оно недоступно - дочитываются потоком
+    if (!readFileMapped(filePath, blockSize, hasher, firstBlock + (hashes.size() - start), maxBlocks - (hashes.size() - start), cacheMode, hashes)) {
+        readFileBuffered(filePath, blockSize, hasher, firstBlock + (hashes.size() - start), maxBlocks - (hashes.size() - start), hashes);
+    }
+}
+
+std::vector<uint32_t> readFile(const fs::path& filePath, size_t blockSize, const BlockHasher& hasher, size_t firstBlock, size_t maxBlocks, CacheMode cacheMode) {
+    std::vector<uint32_t> hashSequence; // вектор последовательности хэшей
+    readFile(filePath.c_str(), blockSize, hasher, hashSequence, firstBlock, maxBlocks, cacheMode);
+    return hashSequence; // возвращение вектора хэшей после завершения чтения файла
+}
+
+void readFileRanges(NativePath filePath, const std::vector<FileRange>& ranges, const BlockHasher& hasher, std::vector<uint32_t>& hashes, CacheMode cacheMode) {
+    const size_t start = hashes.size();
+#if defined(__linux__)
+    if (cacheMode == CacheMode::Direct && readRangesDirect(filePath, ranges, hasher, start, hashes)) {
+        return;
+    }
+#endif
+    if (!readRangesMapped(filePath, ranges, hasher, cacheMode, start, hashes)) {
+        readRangesBuffered(filePath, ranges, hasher, start, hashes); // отображение недоступно: оставшиеся участки читаются потоком
+    }
+}
+
+std::vector<uint32_t> readFileRanges(const fs::path& filePath, const std::vector<FileRange>& ranges, const BlockHasher& hasher, CacheMode cacheMode) {
+    std::vector<uint32_t> hashes;
+    readFileRanges(filePath.c_str(), ranges, hasher, hashes, cacheMode);
+    return hashes;
+}
+
+bool accessMappedPages(void (*access)(void* context), void* context) {
+#if defined(_WIN32)
+    access(context);
+    return true;
+#else
+    installBusHandler();
+    sigjmp_buf jump;
+    sigjmp_buf* const outer = mappedAccessJump; // обращения не вкладываются, но прежняя точка возврата восстанавливается
+    if (sigsetjmp(jump, 0) != 0) { // маска сигналов не сохраняется: обработчик не блокирует SIGBUS
+        mappedAccessJump = outer;
+        return false;
+    }
+    mappedAccessJump = &jump;
+    access(context);
+    mappedAccessJump = outer;
+    return true;
+#endif
+}
+
+#if defined(_WIN32)
+bool MappedFile::open(const fs::path& filePath) {
+    close();
+    HandleGuard file{CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr)};
+    LARGE_INTEGER fileSize;
+    if (file.handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(file.handle, &fileSize) || fileSize.QuadPart == 0) {
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingW(file.handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        return false;
+    }
+    mapping_ = mapping;
+    data_ = static_cast<const unsigned char*>(view);
+    size_ = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_ != nullptr) {
+        UnmapViewOfFile(data_);
+        CloseHandle(mapping_);
+    }
+    data_ = nullptr;
+    mapping_ = nullptr;
+    size_ = 0;
+}
+#else
+bool MappedFile::open(const fs::path& filePath) {
+    close();
+    FileDescriptor file{::open(filePath.c_str(), O_RDONLY | O_CLOEXEC)};
+    struct stat status;
+    if (file.fd < 0 || ::fstat(file.fd, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size == 0) {
+        return false;
+    }
+    void* view = ::mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    data_ = static_cast<const unsigned char*>(view);
+    size_ = static_cast<size_t>(status.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_ != nullptr) {
+        ::munmap(const_cast<unsigned char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+#endif
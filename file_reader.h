@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "block_hash.h"
+#include "block_layout.h"
+
+// Влияние чтения файлов на страничный кэш ОС
+enum class CacheMode {
+    Keep, // прочитанные страницы остаются в кэше
+    Drop, // страницы, которых не было в кэше до чтения, вытесняются сразу после хэширования (Linux: mincore и POSIX_FADV_DONTNEED)
+    Direct // чтение в обход кэша (O_DIRECT, Linux); файловые системы без O_DIRECT читаются как в режиме Drop
+};
+
+// Функция для разбора названия режима кэша ("keep", "drop", "direct"); возвращает false для неизвестного названия
+bool parseCacheMode(const std::string& name, CacheMode& mode);
+
+// Функция для получения названия режима кэша
+const char* cacheModeName(CacheMode mode);
+
+// Путь к файлу в родной для ОС форме с завершающим нулем: по нему файл открывается без создания std::filesystem::path
+using NativePath = const std::filesystem::path::value_type*;
+
+// Функция для чтения файла и добавления в hashes последовательности хэшей (maxBlocks блоков, начиная с блока firstBlock).
+// Обычные файлы хэшируются прямо из отображенных в память страниц (в режиме Direct - из выровненного буфера),
+// остальные читаются через буферизованный поток; неполный последний блок дополняется нулями до blockSize.
+// Буферы берутся из пула потока (см. buffer_pool.h): при достаточной емкости hashes чтение не выделяет память в куче
+void readFile(NativePath filePath, size_t blockSize, const BlockHasher& hasher, std::vector<uint32_t>& hashes, size_t firstBlock = 0, size_t maxBlocks = SIZE_MAX,
+              CacheMode cacheMode = CacheMode::Keep);
+// Последовательность хэшей файла (то же чтение с новым вектором)
+std::vector<uint32_t> readFile(const std::filesystem::path& filePath, size_t blockSize, const BlockHasher& hasher, size_t firstBlock = 0, size_t maxBlocks = SIZE_MAX,
+                               CacheMode cacheMode = CacheMode::Keep);
+
+// Функция для добавления в hashes хэшей участков файла (по одному на участок, без дополнения нулями) за одно открытие файла;
+// если файл короче очередного участка, добавляются хэши только предшествующих участков
+void readFileRanges(NativePath filePath, const std::vector<FileRange>& ranges, const BlockHasher& hasher, std::vector<uint32_t>& hashes,
+                    CacheMode cacheMode = CacheMode::Keep);
+// Хэши участков файла (то же чтение с новым вектором)
+std::vector<uint32_t> readFileRanges(const std::filesystem::path& filePath, const std::vector<FileRange>& ranges, const BlockHasher& hasher,
+                                     CacheMode cacheMode = CacheMode::Keep);
+
+// Функция для обращения к отображенным в память страницам файла, который могут укоротить во время чтения: SIGBUS от страниц
+// за новым концом файла прерывает access(context), и функция возвращает false (POSIX; на Windows файл с отображением укоротить нельзя).
+// access не должен выделять память и создавать объекты с деструкторами: при прерывании они не вызываются
+bool accessMappedPages(void (*access)(void* context), void* context);
+
+// Файл, целиком отображенный в память только для чтения
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    // Отображение файла; возвращает false, если файл не открывается, пуст или не отображается
+    bool open(const std::filesystem::path& filePath);
+    void close();
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const unsigned char* data_ = nullptr; // начало отображения
+    size_t size_ = 0; // размер отображения
+#if defined(_WIN32)
+    void* mapping_ = nullptr; // объект отображения Windows
+#endif
+};
@@ -0,0 +1,104 @@
+#include "file_table.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+NativeName StringArena::store(NativeName text) {
+    if (text.size() > chunkLength) { // длинная строка получает отдельный блок, текущий блок продолжает заполняться
+        std::unique_ptr<fs::path::value_type[]> chunk(new fs::path::value_type[text.size()]);
+        std::copy(text.begin(), text.end(), chunk.get());
+        NativeName stored(chunk.get(), text.size());
+        allocated_ += text.size();
+        chunks_.insert(chunks_.empty() ? chunks_.end() : chunks_.end() - 1, std::move(chunk));
+        return stored;
+    }
+    if (capacity_ - used_ < text.size()) {
+        chunks_.emplace_back(new fs::path::value_type[chunkLength]);
+        used_ = 0;
+        capacity_ = chunkLength;
+        allocated_ += chunkLength;
+    }
+    fs::path::value_type* target = chunks_.back().get() + used_;
+    std::copy(text.begin(), text.end(), target);
+    used_ += text.size();
+    return NativeName(target, text.size());
+}
+
+void StringArena::append(StringArena&& other) {
+    if (other.chunks_.empty()) {
+        return;
+    }
+    // Последний блок другой арены становится текущим, чтобы его свободное место не пропадало
+    chunks_.insert(chunks_.end(), std::make_move_iterator(other.chunks_.begin()), std::make_move_iterator(other.chunks_.end()));
+    used_ = other.used_;
+    capacity_ = other.capacity_;
+    allocated_ += other.allocated_;
+    other.chunks_.clear();
+    other.used_ = 0;
+    other.capacity_ = 0;
+    other.allocated_ = 0;
+}
+
+void FileTable::add(const fs::path& path, const FileMetadata& metadata) {
+    const auto& native = path.native();
+    size_t nameLength = path.filename().native().size();
+    NativeName directory = NativeName(native).substr(0, native.size() - nameLength);
+    if (directories_.empty() || directories_.back() != directory) {
+        if (directories_.size() >= UINT32_MAX) {
+            throw std::runtime_error("Too many directories to compare files in");
+        }
+        directories_.push_back(strings_.store(directory));
+    }
+    directoryIndices_.push_back(static_cast<uint32_t>(directories_.size() - 1));
+    names_.push_back(strings_.store(NativeName(native).substr(native.size() - nameLength)));
+    sizes_.push_back(metadata.size);
+    devices_.push_back(metadata.device);
+    inodes_.push_back(metadata.inode);
+    mtimes_.push_back(metadata.mtime);
+}
+
+void FileTable::append(FileTable&& other) {
+    if (directories_.size() + other.directories_.size() > UINT32_MAX) {
+        throw std::runtime_error("Too many directories to compare files in");
+    }
+    const uint32_t base = static_cast<uint32_t>(directories_.size()); // индексы директорий другой таблицы сдвигаются
+    strings_.append(std::move(other.strings_));
+    directories_.insert(directories_.end(), other.directories_.begin(), other.directories_.end());
+    for (uint32_t index : other.directoryIndices_) {
+        directoryIndices_.push_back(base + index);
+    }
+    names_.insert(names_.end(), other.names_.begin(), other.names_.end());
+    sizes_.insert(sizes_.end(), other.sizes_.begin(), other.sizes_.end());
+    devices_.insert(devices_.end(), other.devices_.begin(), other.devices_.end());
+    inodes_.insert(inodes_.end(), other.inodes_.begin(), other.inodes_.end());
+    mtimes_.insert(mtimes_.end(), other.mtimes_.begin(), other.mtimes_.end());
+    other = FileTable();
+}
+
+size_t FileTable::memoryUsage() const {
+    return strings_.memoryUsage() + directories_.capacity() * sizeof(NativeName) + directoryIndices_.capacity() * sizeof(uint32_t) +
+           names_.capacity() * sizeof(NativeName) + (sizes_.capacity() + devices_.capacity() + inodes_.capacity()) * sizeof(uint64_t) +
+           mtimes_.capacity() * sizeof(int64_t);
+}
+
+void FileTable::setMetadata(size_t index, const FileMetadata& metadata) {
+    sizes_[index] = metadata.size;
+    devices_[index] = metadata.device;
+    inodes_[index] = metadata.inode;
+    mtimes_[index] = metadata.mtime;
+}
+
+fs::path FileTable::path(size_t index) const {
+    fs::path::string_type native;
+    nativePath(index, native);
+    return fs::path(std::move(native));
+}
+
+void FileTable::nativePath(size_t index, fs::path::string_type& target) const {
+    NativeName directory = directories_[directoryIndices_[index]];
+    target.reserve(directory.size() + names_[index].size());
+    target.assign(directory.begin(), directory.end());
+    target.append(names_[index].begin(), names_[index].end());
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "directory_walker.h"
+
+// Арена строк: строки копируются в общие большие блоки, ссылки на них не меняются при добавлении и переносе арены
+class StringArena {
+public:
+    // Копирование строки в арену
+    NativeName store(NativeName text);
+    // Перенос всех блоков другой арены (ссылки на ее строки остаются действительными)
+    void append(StringArena&& other);
+    // Память блоков в байтах
+    size_t memoryUsage() const { return allocated_ * sizeof(std::filesystem::path::value_type); }
+
+private:
+    static constexpr size_t chunkLength = 64 * 1024; // размер блока в символах
+    std::vector<std::unique_ptr<std::filesystem::path::value_type[]>> chunks_;
+    size_t used_ = 0; // занято символов в последнем блоке
+    size_t capacity_ = 0; // размер последнего блока
+    size_t allocated_ = 0; // символы во всех блоках
+};
+
+// Компактная таблица файлов-кандидатов в виде структуры массивов: вместо объекта с собственным путем на каждый файл
+// хранится индекс директории и имя в арене строк, путь директории хранится один раз, метаданные - в плоских массивах
+class FileTable {
+public:
+    // Добавление файла; подряд идущие файлы одной директории (как их выдает обход) ссылаются на одну запись директории
+    void add(const std::filesystem::path& path, const FileMetadata& metadata);
+    // Перенос всех файлов другой таблицы в конец этой
+    void append(FileTable&& other);
+
+    size_t size() const { return names_.size(); } // количество файлов
+    std::filesystem::path path(size_t index) const; // путь к файлу (совпадает с переданным в add)
+    void nativePath(size_t index, std::filesystem::path::string_type& target) const; // тот же путь в target без выделения памяти, если ее хватает
+    uint64_t fileSize(size_t index) const { return sizes_[index]; }
+    uint64_t device(size_t index) const { return devices_[index]; }
+    uint64_t inode(size_t index) const { return inodes_[index]; }
+    FileMetadata metadata(size_t index) const { return {sizes_[index], devices_[index], inodes_[index], mtimes_[index]}; }
+    NativeName directory(size_t index) const { return directories_[directoryIndices_[index]]; } // путь директории с завершающим разделителем
+    NativeName name(size_t index) const { return names_[index]; } // имя файла
+    // Память таблицы в байтах (строки и выделенная емкость массивов)
+    size_t memoryUsage() const;
+    // Замена метаданных файла (например, изменившегося после обхода)
+    void setMetadata(size_t index, const FileMetadata& metadata);
+
+private:
+    StringArena strings_; // пути директорий и имена файлов
+    std::vector<NativeName> directories_; // пути директорий вместе с завершающим разделителем
+    std::vector<uint32_t> directoryIndices_; // директория каждого файла
+    std::vector<NativeName> names_; // имена файлов
+    std::vector<uint64_t> sizes_; // размеры файлов
+    std::vector<uint64_t> devices_; // устройства
+    std::vector<uint64_t> inodes_; // inode (0 - неизвестен)
+    std::vector<int64_t> mtimes_; // время последнего изменения в наносекундах
+};
@@ -0,0 +1,131 @@
+#include "glob_matcher.h"
+
+namespace {
+
+inline unsigned char toLowerAscii(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c - 'A' + 'a') : c;
+}
+
+} // namespace
+
+GlobPattern::GlobPattern(const std::string& pattern, bool caseSensitive) : caseSensitive_(caseSensitive) {
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(pattern[i]);
+        if (c == '*') {
+            if (tokens_.empty() || tokens_.back().kind != Token::AnySequence) { // несколько * подряд равносильны одной
+                tokens_.push_back({Token::AnySequence, 0, 0});
+            }
+            continue;
+        }
+        if (c == '?') {
+            tokens_.push_back({Token::AnyChar, 0, 0});
+            continue;
+        }
+        if (c == '[') {
+            size_t j = i + 1;
+            bool negated = j < pattern.size() && (pattern[j] == '!' || pattern[j] == '^');
+            if (negated) {
+                ++j;
+            }
+            size_t first = j; // ']' сразу после '[' считается обычным символом
+            while (j < pattern.size() && (pattern[j] != ']' || j == first)) {
+                ++j;
+            }
+            if (j < pattern.size()) { // найдена закрывающая скобка
+                std::bitset<256> set;
+                for (size_t k = first; k < j; ++k) {
+                    unsigned char low = static_cast<unsigned char>(pattern[k]);
+                    unsigned char high = low;
+                    if (k + 2 < j && pattern[k + 1] == '-') { // диапазон a-z
+                        high = static_cast<unsigned char>(pattern[k + 2]);
+                        k += 2;
+                    }
+                    for (unsigned int value = low; value <= high; ++value) {
+                        set.set(value);
+                        if (!caseSensitive_) {
+                            unsigned char lower = toLowerAscii(static_cast<unsigned char>(value));
+                            set.set(lower);
+                            if (lower >= 'a' && lower <= 'z') {
+                                set.set(lower - 'a' + 'A');
+                            }
+                        }
+                    }
+                }
+                if (negated) {
+                    set.flip();
+                }
+                classes_.push_back(set);
+                tokens_.push_back({Token::CharClass, 0, static_cast<uint32_t>(classes_.size() - 1)});
+                i = j;
+                continue;
+            }
+            // Без закрывающей скобки '[' - обычный символ
+        }
+        tokens_.push_back({Token::Literal, caseSensitive_ ? c : toLowerAscii(c), 0});
+    }
+}
+
+bool GlobPattern::matchesOne(const Token& token, unsigned char c) const {
+    switch (token.kind) {
+    case Token::Literal: return token.literal == (caseSensitive_ ? c : toLowerAscii(c));
+    case Token::AnyChar: return true;
+    case Token::CharClass: return classes_[token.classIndex].test(c);
+    case Token::AnySequence: break;
+    }
+    return false;
+}
+
+bool GlobPattern::matches(std::string_view name) const {
+    // Жадное сопоставление с возвратом к последней *: достаточно помнить одну позицию, поэтому время O(n*m) без рекурсии
+    const size_t none = static_cast<size_t>(-1);
+    size_t token = 0;
+    size_t position = 0;
+    size_t starToken = none; // элемент маски после последней встреченной *
+    size_t starPosition = 0; // позиция в имени, с которой сопоставляется последняя *
+    while (position < name.size()) {
+        if (token < tokens_.size() && tokens_[token].kind == Token::AnySequence) {
+            starToken = ++token;
+            starPosition = position;
+        } else if (token < tokens_.size() && matchesOne(tokens_[token], static_cast<unsigned char>(name[position]))) {
+            ++token;
+            ++position;
+        } else if (starToken != none) { // * поглощает еще один символ
+            token = starToken;
+            position = ++starPosition;
+        } else {
+            return false;
+        }
+    }
+    while (token < tokens_.size() && tokens_[token].kind == Token::AnySequence) {
+        ++token;
+    }
+    return token == tokens_.size();
+}
+
+GlobFilter::GlobFilter(const std::vector<std::string>& includeMasks, const std::vector<std::string>& excludeMasks, bool caseSensitive) {
+    for (const auto& mask : includeMasks) {
+        include_.emplace_back(mask, caseSensitive);
+    }
+    for (const auto& mask : excludeMasks) {
+        exclude_.emplace_back(mask, caseSensitive);
+    }
+}
+
+bool GlobFilter::matches(std::string_view name) const {
+    bool included = include_.empty(); // без масок включения подходят все имена
+    for (const auto& pattern : include_) {
+        if (pattern.matches(name)) {
+            included = true;
+            break;
+        }
+    }
+    if (!included) {
+        return false;
+    }
+    for (const auto& pattern : exclude_) {
+        if (pattern.matches(name)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Маска имени файла, заранее скомпилированная в последовательность элементов.
+// Поддерживаются * (любая последовательность), ? (любой символ), [abc], [a-z] и [!abc] ([^abc]);
+// сравнение побайтовое, без учета регистра - только для латиницы; сопоставление не выделяет память
+class GlobPattern {
+public:
+    GlobPattern(const std::string& pattern, bool caseSensitive);
+
+    // Подходит ли имя под маску целиком
+    bool matches(std::string_view name) const;
+
+private:
+    // Элемент маски
+    struct Token {
+        enum Kind : uint8_t { Literal, AnyChar, AnySequence, CharClass } kind;
+        unsigned char literal; // символ для Literal
+        uint32_t classIndex; // номер множества в classes_ для CharClass
+    };
+
+    bool matchesOne(const Token& token, unsigned char c) const;
+
+    std::vector<Token> tokens_;
+    std::vector<std::bitset<256>> classes_; // множества символов для [...]
+    bool caseSensitive_;
+};
+
+// Набор масок: имя подходит, если оно подходит хотя бы под одну маску включения и ни под одну маску исключения
+class GlobFilter {
+public:
+    GlobFilter(const std::vector<std::string>& includeMasks, const std::vector<std::string>& excludeMasks, bool caseSensitive);
+
+    bool matches(std::string_view name) const;
+
+private:
+    std::vector<GlobPattern> include_;
+    std::vector<GlobPattern> exclude_;
+};
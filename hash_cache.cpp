@@ -0,0 +1,152 @@
+#include "hash_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <tuple>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char cacheMagic[4] = {'L', '7', 'H', 'C'};
+constexpr uint32_t cacheVersion = 2; // версия формата, увеличивается при любом его изменении
+
+// Заголовок файла кэша
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t entryCount;
+    uint64_t hashCount;
+};
+
+static_assert(sizeof(CacheHeader) == 24, "cache header layout must not depend on the compiler");
+static_assert(sizeof(CacheKey) == 40, "cache key layout must not depend on the compiler");
+
+} // namespace
+
+bool CacheKey::operator<(const CacheKey& other) const {
+    return std::tie(device, inode, size, mtime, blockSize, algorithm, strategy) < std::tie(other.device, other.inode, other.size, other.mtime, other.blockSize, other.algorithm, other.strategy);
+}
+
+bool CacheKey::operator==(const CacheKey& other) const {
+    return std::tie(device, inode, size, mtime, blockSize, algorithm, strategy) == std::tie(other.device, other.inode, other.size, other.mtime, other.blockSize, other.algorithm, other.strategy);
+}
+
+bool readFileIdentity(const fs::path& filePath, CacheKey& key) {
+#if defined(_WIN32)
+    HANDLE file = CreateFileW(filePath.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    BY_HANDLE_FILE_INFORMATION info;
+    bool ok = GetFileInformationByHandle(file, &info) != 0;
+    CloseHandle(file);
+    if (!ok) {
+        return false;
+    }
+    key.device = info.dwVolumeSerialNumber;
+    key.inode = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    key.mtime = static_cast<int64_t>((static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime) * 100; // интервалы по 100 нс
+#else
+    struct stat status;
+    if (::stat(filePath.c_str(), &status) != 0) {
+        return false;
+    }
+    key.device = static_cast<uint64_t>(status.st_dev);
+    key.inode = static_cast<uint64_t>(status.st_ino);
+#if defined(__APPLE__)
+    key.mtime = static_cast<int64_t>(status.st_mtimespec.tv_sec) * 1000000000 + status.st_mtimespec.tv_nsec;
+#else
+    key.mtime = static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+#endif
+    return true;
+}
+
+void HashCache::load(const fs::path& cachePath) {
+    entries_ = nullptr;
+    entryCount_ = 0;
+    hashes_ = nullptr;
+    hashCount_ = 0;
+    if (!file_.open(cachePath)) { // кэша еще нет
+        return;
+    }
+    CacheHeader header;
+    bool valid = file_.size() >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, file_.data(), sizeof(header));
+        valid = std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 && header.version == cacheVersion &&
+                header.entryCount <= (file_.size() - sizeof(header)) / sizeof(Entry) &&
+                header.hashCount == (file_.size() - sizeof(header) - header.entryCount * sizeof(Entry)) / sizeof(uint32_t);
+    }
+    if (!valid) {
+        std::cerr << "Ignoring invalid hash cache: " << cachePath << std::endl;
+        file_.close();
+        return;
+    }
+    entries_ = reinterpret_cast<const Entry*>(file_.data() + sizeof(header)); // отображение выровнено по странице, а записи - по 8 байтов
+    entryCount_ = static_cast<size_t>(header.entryCount);
+    hashes_ = reinterpret_cast<const uint32_t*>(entries_ + entryCount_);
+    hashCount_ = static_cast<size_t>(header.hashCount);
+}
+
+bool HashCache::find(const CacheKey& key, std::vector<uint32_t>& hashes) const {
+    const Entry* end = entries_ + entryCount_;
+    const Entry* entry = std::lower_bound(entries_, end, key, [](const Entry& item, const CacheKey& value) { return item.key < value; });
+    if (entry == end || !(entry->key == key) || entry->hashOffset + entry->hashCount > hashCount_) {
+        return false;
+    }
+    hashes.assign(hashes_ + entry->hashOffset, hashes_ + entry->hashOffset + entry->hashCount);
+    return true;
+}
+
+void HashCache::store(const CacheKey& key, const std::vector<uint32_t>& hashes) {
+    newEntries_.push_back({key, newHashes_.size(), hashes.size()});
+    newHashes_.insert(newHashes_.end(), hashes.begin(), hashes.end());
+}
+
+void HashCache::save(const fs::path& cachePath) {
+    file_.close(); // на Windows отображенный файл нельзя заменить
+    entries_ = nullptr;
+    entryCount_ = 0;
+    hashes_ = nullptr;
+    hashCount_ = 0;
+    std::sort(newEntries_.begin(), newEntries_.end(), [](const Entry& left, const Entry& right) { return left.key < right.key; });
+    newEntries_.erase(std::unique(newEntries_.begin(), newEntries_.end(), [](const Entry& left, const Entry& right) { return left.key == right.key; }), newEntries_.end()); // жесткие ссылки на один файл
+    CacheHeader header;
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.entryCount = newEntries_.size();
+    header.hashCount = newHashes_.size();
+    fs::path temporaryPath = cachePath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(newEntries_.data()), static_cast<std::streamsize>(newEntries_.size() * sizeof(Entry)));
+        out.write(reinterpret_cast<const char*>(newHashes_.data()), static_cast<std::streamsize>(newHashes_.size() * sizeof(uint32_t)));
+        if (!out.flush()) {
+            std::cerr << "Cannot write hash cache: " << temporaryPath << std::endl;
+            out.close();
+            std::error_code error;
+            fs::remove(temporaryPath, error);
+            return;
+        }
+    }
+    std::error_code error;
+    fs::rename(temporaryPath, cachePath, error);
+    if (error) {
+        std::cerr << "Cannot replace hash cache " << cachePath << ": " << error.message() << std::endl;
+        fs::remove(temporaryPath, error);
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "block_hash.h"
+#include "file_reader.h"
+
+// Ключ записи кэша: файл считается неизменным, пока совпадают устройство, inode, размер и время изменения;
+// хэши подходят, только если получены тем же разбиением на блоки и тем же алгоритмом
+struct CacheKey {
+    uint64_t device = 0; // устройство (на Windows - серийный номер тома)
+    uint64_t inode = 0; // inode (на Windows - индекс файла)
+    uint64_t size = 0; // размер файла
+    int64_t mtime = 0; // время последнего изменения в наносекундах
+    uint32_t blockSize = 0; // размер блока, которым получены хэши
+    uint16_t algorithm = 0; // алгоритм хэширования блоков (HashAlgorithm)
+    uint16_t strategy = 0; // стратегия разбиения на блоки (BlockStrategy)
+
+    bool operator<(const CacheKey& other) const;
+    bool operator==(const CacheKey& other) const;
+};
+
+// Функция для получения устройства, inode и времени изменения файла; возвращает false, если файл недоступен
+bool readFileIdentity(const std::filesystem::path& filePath, CacheKey& key);
+
+// Постоянный кэш последовательностей хэшей блоков.
+// Формат файла (порядок байтов узла): заголовок {"L7HC", версия, количество записей, количество хэшей},
+// массив записей фиксированного размера, отсортированный по ключу, и общий массив хэшей;
+// загруженный кэш отображается в память, поиск записи - двоичный
+class HashCache {
+public:
+    // Загрузка кэша; отсутствующий, устаревший или поврежденный файл дает пустой кэш
+    void load(const std::filesystem::path& cachePath);
+    // Поиск сохраненных хэшей файла (первых блоков, которые были вычислены при прошлом запуске)
+    bool find(const CacheKey& key, std::vector<uint32_t>& hashes) const;
+    // Добавление хэшей файла для следующей записи кэша
+    void store(const CacheKey& key, const std::vector<uint32_t>& hashes);
+    // Атомарная перезапись кэша: данные пишутся во временный файл, который затем переименовывается
+    void save(const std::filesystem::path& cachePath);
+
+private:
+    // Запись кэша на диске
+    struct Entry {
+        CacheKey key;
+        uint64_t hashOffset; // индекс первого хэша в общем массиве
+        uint64_t hashCount; // количество хэшей
+    };
+
+    MappedFile file_; // отображенный в память загруженный кэш
+    const Entry* entries_ = nullptr; // записи загруженного кэша
+    size_t entryCount_ = 0;
+    const uint32_t* hashes_ = nullptr; // хэши загруженного кэша
+    size_t hashCount_ = 0;
+    std::vector<Entry> newEntries_; // записи для следующей записи кэша
+    std::vector<uint32_t> newHashes_; // хэши для следующей записи кэша
+};
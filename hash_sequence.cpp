@@ -0,0 +1,126 @@
+#include "hash_sequence.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "file_reader.h"
+#include "io_scheduler.h"
+#include "resource_governor.h"
+
+std::vector<uint32_t> LazyHashSequence::computedHashes() const {
+    std::vector<uint32_t> hashes;
+    if (hasFirst_) {
+        hashes.reserve(rest_.size() + 1);
+        hashes.push_back(first_);
+        hashes.insert(hashes.end(), rest_.begin(), rest_.end());
+    }
+    return hashes;
+}
+
+void LazyHashSequence::preload(const std::vector<uint32_t>& hashes) {
+    if (hashes.size() > computedCount() && hashes.size() <= blockCount_) {
+        first_ = hashes.front();
+        hasFirst_ = true;
+        rest_.assign(hashes.begin() + 1, hashes.end());
+    }
+}
+
+void LazyHashSequence::readThrough(size_t index) {
+    const size_t computed = computedCount();
+    const BlockLayout& layout = context_->layout;
+    // Путь, участки и хэши чтения в памяти потока: после первых файлов чтение не выделяет память в куче
+    thread_local std::filesystem::path::string_type filePath;
+    thread_local std::vector<FileRange> ranges;
+    thread_local std::vector<uint32_t> next;
+    context_->files.nativePath(file_, filePath);
+    next.clear();
+    uint64_t bytes = 0; // прочитанные байты (без дополнения последнего фиксированного блока нулями)
+    size_t count = 0; // блоки фиксированного разбиения, которые нужно прочитать
+    if (layout.strategy() == BlockStrategy::Fixed) {
+        // Первое обращение читает один блок, дальше объем чтения удваивается, чтобы совпадающие файлы не открывались на каждый блок
+        size_t maxReadAhead = std::max<size_t>(1, maxReadAheadBytes / layout.blockSize());
+        count = std::min(std::max(index + 1 - computed, std::min(std::max<size_t>(computed, 1), maxReadAhead)), blockCount_ - computed);
+        bytes = std::min<uint64_t>(fileSize(), (computed + count) * layout.blockSize()) - std::min<uint64_t>(fileSize(), computed * layout.blockSize());
+    } else { // адаптивные блоки и так растут, читаются только запрошенные
+        ranges.clear();
+        for (size_t block = computed; block <= index; ++block) {
+            ranges.push_back(layout.block(fileSize(), block));
+            bytes += ranges.back().length;
+        }
+    }
+    if (context_->throttle != nullptr) { // ожидание до занятия слота устройства: пока поток ждет, устройство читают другие
+        context_->throttle->acquire(bytes);
+    }
+    IoScheduler::Permit permit = context_->scheduler != nullptr ? context_->scheduler->acquire(context_->files.device(file_)) : IoScheduler::Permit();
+    if (layout.strategy() == BlockStrategy::Fixed) {
+        readFile(filePath.c_str(), static_cast<size_t>(layout.blockSize()), context_->hasher, next, computed, count, context_->cacheMode);
+        bytes = std::min<uint64_t>(fileSize(), (computed + next.size()) * layout.blockSize()) - std::min<uint64_t>(fileSize(), computed * layout.blockSize());
+    } else {
+        readFileRanges(filePath.c_str(), ranges, context_->hasher, next, context_->cacheMode);
+    }
+    if (context_->metrics != nullptr) { // одно обновление счетчиков на чтение, а не на блок
+        context_->metrics->filesHashed.add(computed == 0 && !next.empty() ? 1 : 0);
+        context_->metrics->blocksHashed.add(next.size());
+        context_->metrics->bytesRead.add(bytes);
+    }
+    auto it = next.begin();
+    if (!hasFirst_ && it != next.end()) {
+        first_ = *it++;
+        hasFirst_ = true;
+    }
+    rest_.insert(rest_.end(), it, next.end());
+    if (index >= computedCount()) { // файл стал короче с момента обхода директорий
+        throw std::runtime_error("File changed during scan: " + path().string());
+    }
+}
+
+bool LazyHashSequence::tryHashAt(size_t index, uint32_t& hash) {
+    if (failed_) {
+        return false;
+    }
+    try {
+        hash = hashAt(index);
+        return true;
+    } catch (const std::runtime_error& error) { // файл удален или стал короче с момента обхода: поиск продолжается без него
+        failed_ = true;
+        std::cerr << std::string(error.what()) + ", skipping the file\n";
+        return false;
+    }
+}
+
+void refineGroup(std::vector<LazyHashSequence*> group, std::vector<std::vector<LazyHashSequence*>>& duplicates) {
+    std::vector<std::pair<std::vector<LazyHashSequence*>, size_t>> pending; // стек частей группы и номеров блоков, с которых их нужно уточнять
+    pending.emplace_back(std::move(group), 0);
+    std::unordered_map<uint32_t, std::vector<LazyHashSequence*>> parts; // разбиение части по хэшу блока
+    while (!pending.empty()) {
+        std::vector<LazyHashSequence*> part = std::move(pending.back().first);
+        size_t block = pending.back().second;
+        pending.pop_back();
+        while (part.size() > 1) {
+            if (block == part.front()->blockCount()) { // все блоки совпали => файлы части являются дубликатами
+                duplicates.push_back(std::move(part));
+                break;
+            }
+            parts.clear();
+            for (auto* file : part) {
+                uint32_t hash;
+                if (file->tryHashAt(block, hash)) {
+                    parts[hash].push_back(file);
+                }
+            }
+            ++block;
+            if (parts.size() == 1) { // блок совпал у всех прочитанных файлов части, уточняем следующий блок
+                part = std::move(parts.begin()->second);
+                continue;
+            }
+            for (auto& item : parts) {
+                if (item.second.size() > 1) { // части из одного файла дубликатов не содержат
+                    pending.emplace_back(std::move(item.second), block);
+                }
+            }
+            break;
+        }
+    }
+}
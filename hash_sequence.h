@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "block_hash.h"
+#include "block_layout.h"
+#include "file_reader.h"
+#include "file_table.h"
+#include "scan_metrics.h"
+
+class IoScheduler;
+class ReadThrottle;
+
+// Параметры чтения, общие для всех последовательностей хэшей
+struct HashingContext {
+    const FileTable& files; // файлы-кандидаты
+    const BlockLayout& layout; // разбиение файлов на блоки
+    const BlockHasher& hasher; // хэш-функция блоков
+    ScanMetrics* metrics = nullptr; // счетчики прочитанных файлов, байтов и блоков (nullptr - не ведутся)
+    IoScheduler* scheduler = nullptr; // ограничение одновременных чтений с устройства (nullptr - без ограничения)
+    CacheMode cacheMode = CacheMode::Keep; // влияние чтений на страничный кэш
+    ReadThrottle* throttle = nullptr; // ограничение скорости чтения (nullptr - без ограничения)
+};
+
+// Класс ленивой последовательности хэшей файла: блоки читаются и хэшируются только тогда, когда они нужны для сравнения.
+// Запись компактна: путь и размер берутся из таблицы кандидатов, хэш первого блока хранится в самой записи
+// (большинство файлов отсеивается по нему), память под остальные хэши выделяется только для совпавших файлов
+class LazyHashSequence {
+public:
+    LazyHashSequence(const HashingContext& context, uint32_t file)
+        : context_(&context), file_(file), blockCount_(static_cast<size_t>(context.layout.blockCount(context.files.fileSize(file)))) {}
+
+    uint32_t file() const { return file_; } // индекс файла в таблице кандидатов
+    std::filesystem::path path() const { return context_->files.path(file_); }
+    uintmax_t fileSize() const { return context_->files.fileSize(file_); }
+    size_t blockCount() const { return blockCount_; } // количество блоков в файле
+    size_t computedCount() const { return hasFirst_ ? rest_.size() + 1 : 0; } // количество вычисленных хэшей
+
+    // Уже вычисленные хэши
+    std::vector<uint32_t> computedHashes() const;
+    // Подстановка хэшей первых блоков, сохраненных в кэше при прошлом запуске
+    void preload(const std::vector<uint32_t>& hashes);
+
+    // Подстановка хэша первого блока, прочитанного асинхронно
+    void setFirstHash(uint32_t hash) {
+        if (!hasFirst_) {
+            first_ = hash;
+            hasFirst_ = true;
+        }
+    }
+
+    // Хэш блока с номером index (при необходимости дочитывает файл); исключение, если файл нельзя прочитать
+    uint32_t hashAt(size_t index) {
+        if (index >= computedCount()) {
+            readThrough(index);
+        }
+        return index == 0 ? first_ : rest_[index - 1];
+    }
+
+    // Хэш блока с номером index без исключений: файл, удаленный или измененный после обхода директорий, помечается
+    // недоступным с предупреждением в stderr, и функция возвращает false (для такого файла - всегда)
+    bool tryHashAt(size_t index, uint32_t& hash);
+    bool failed() const { return failed_; } // файл недоступен: его хэши не годятся ни для групп, ни для кэша
+
+private:
+    // Чтение файла до блока index включительно
+    void readThrough(size_t index);
+
+    static constexpr size_t maxReadAheadBytes = 8 * 1024 * 1024; // предел упреждающего чтения за одно обращение
+    const HashingContext* context_; // таблица кандидатов и параметры хэширования
+    uint32_t file_; // индекс файла в таблице кандидатов
+    uint32_t first_ = 0; // хэш первого блока
+    bool hasFirst_ = false; // хэш первого блока вычислен
+    bool failed_ = false; // файл не удалось дочитать
+    size_t blockCount_; // количество блоков в файле
+    std::vector<uint32_t> rest_; // вычисленные хэши следующих блоков
+};
+
+// Функция для разбиения группы файлов одного размера на группы дубликатов уточнением разбиения:
+// группа делится по хэшу очередного блока, дальше уточняются только части, в которых больше одного файла.
+// Файлы, которые не удалось прочитать, выбывают из группы
+void refineGroup(std::vector<LazyHashSequence*> group, std::vector<std::vector<LazyHashSequence*>>& duplicates);
@@ -0,0 +1,135 @@
+#include "io_scheduler.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <string>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Состояние устройства: тип и занятые слоты чтения
+struct IoScheduler::DeviceState {
+    DeviceKind kind = DeviceKind::Unknown;
+    size_t limit = 1; // наибольшее количество одновременных чтений
+    size_t active = 0; // выданные разрешения
+    std::mutex mutex;
+    std::condition_variable released; // разрешение возвращено
+};
+
+namespace {
+
+#if defined(__linux__)
+// Функция для чтения признака вращающегося диска из sysfs; false - файла нет (у разделов он лежит в директории всего диска)
+bool readRotational(const fs::path& path, bool& rotational) {
+    std::ifstream in(path);
+    int value = 0;
+    if (!(in >> value)) {
+        return false;
+    }
+    rotational = value != 0;
+    return true;
+}
+
+// Функция для определения типа блочного устройства по номеру st_dev
+DeviceKind detectKind(uint64_t device) {
+    const dev_t id = static_cast<dev_t>(device);
+    if (::major(id) == 0) { // безымянные устройства: tmpfs, overlayfs, btrfs, NFS и т.п.
+        return DeviceKind::Unknown;
+    }
+    const fs::path block = "/sys/dev/block/" + std::to_string(::major(id)) + ":" + std::to_string(::minor(id));
+    bool rotational = false;
+    if (!readRotational(block / "queue" / "rotational", rotational) && !readRotational(block / ".." / "queue" / "rotational", rotational)) {
+        return DeviceKind::Unknown;
+    }
+    return rotational ? DeviceKind::Rotational : DeviceKind::SolidState;
+}
+
+// Функция для получения физического смещения первого экстента файла (FIEMAP); false - файловая система его не сообщает
+bool firstExtentOffset(const fs::path& path, uint64_t& offset) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    alignas(fiemap) unsigned char buffer[sizeof(fiemap) + sizeof(fiemap_extent)] = {}; // заголовок и место под один экстент
+    fiemap* map = reinterpret_cast<fiemap*>(buffer);
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1; // порядок задает начало файла, остальные экстенты не нужны
+    bool found = ::ioctl(fd, FS_IOC_FIEMAP, map) == 0 && map->fm_mapped_extents == 1 &&
+                 (map->fm_extents[0].fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DATA_INLINE)) == 0;
+    ::close(fd);
+    if (found) {
+        offset = map->fm_extents[0].fe_physical;
+    }
+    return found;
+}
+#endif
+
+} // namespace
+
+IoScheduler::Permit::~Permit() {
+    if (device_ != nullptr) {
+        {
+            std::lock_guard<std::mutex> lock(device_->mutex);
+            --device_->active;
+        }
+        device_->released.notify_one();
+    }
+}
+
+IoScheduler::IoScheduler(DeviceLimits limits) : limits_(limits) {}
+
+IoScheduler::~IoScheduler() = default;
+
+DeviceKind IoScheduler::kind(uint64_t device) {
+    return state(device).kind;
+}
+
+size_t IoScheduler::limit(uint64_t device) {
+    return state(device).limit;
+}
+
+IoScheduler::Locality IoScheduler::locality(const fs::path& path, uint64_t device, uint64_t inode) {
+#if defined(__linux__)
+    uint64_t offset = 0;
+    if (state(device).kind == DeviceKind::Rotational && firstExtentOffset(path, offset)) {
+        return {false, offset};
+    }
+#else
+    (void)path;
+    (void)device;
+#endif
+    return {true, inode};
+}
+
+IoScheduler::Permit IoScheduler::acquire(uint64_t device) {
+    DeviceState& entry = state(device);
+    std::unique_lock<std::mutex> lock(entry.mutex);
+    entry.released.wait(lock, [&entry] { return entry.active < entry.limit; });
+    ++entry.active;
+    Permit permit;
+    permit.device_ = &entry;
+    return permit;
+}
+
+IoScheduler::DeviceState& IoScheduler::state(uint64_t device) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<DeviceState>& entry = devices_[device];
+    if (!entry) { // чтение sysfs под общей блокировкой: устройств мало, каждое определяется один раз
+        entry = std::make_unique<DeviceState>();
+#if defined(__linux__)
+        entry->kind = detectKind(device);
+#endif
+        entry->limit = std::max<size_t>(1, entry->kind == DeviceKind::Rotational ? limits_.rotational : limits_.solidState);
+    }
+    return *entry;
+}
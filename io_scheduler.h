@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+// Тип устройства, на котором лежит файл
+enum class DeviceKind {
+    Rotational, // вращающийся диск: одновременные чтения вызывают перемещения головки
+    SolidState, // SSD, NVMe и прочие устройства без перемещения головки
+    Unknown // не блочное устройство (tmpfs, сетевые и составные файловые системы) или ОС без таких сведений
+};
+
+// Ограничения одновременных чтений с одного устройства
+struct DeviceLimits {
+    size_t rotational = 2; // вращающийся диск
+    size_t solidState = 64; // SSD и устройства неизвестного типа
+};
+
+// Планировщик чтений: определяет тип устройства каждого файла (на Linux - по /sys/dev/block/<major>:<minor>/queue/rotational),
+// ограничивает количество одновременных чтений с устройства и задает порядок чтения внутри устройства: на вращающихся дисках -
+// по физическому смещению начала файла (FIEMAP), иначе (и для файлов, смещение которых не получено) по inode
+// (файлы, созданные подряд, обычно лежат рядом)
+class IoScheduler {
+    struct DeviceState;
+
+public:
+    // Разрешение на чтение с устройства: пока оно существует, занят один из слотов чтения устройства
+    class Permit {
+    public:
+        Permit() = default;
+        Permit(Permit&& other) noexcept : device_(other.device_) { other.device_ = nullptr; }
+        Permit& operator=(Permit&&) = delete;
+        ~Permit();
+
+    private:
+        friend class IoScheduler;
+        DeviceState* device_ = nullptr;
+    };
+
+    explicit IoScheduler(DeviceLimits limits = DeviceLimits());
+    ~IoScheduler();
+
+    // Тип устройства (определяется при первом обращении; потокобезопасно)
+    DeviceKind kind(uint64_t device);
+    // Наибольшее количество одновременных чтений с устройства
+    size_t limit(uint64_t device);
+    // Ключ порядка чтения файла на его устройстве (меньше - раньше): (false, физическое смещение) для файлов, расположение
+    // которых известно из FIEMAP, иначе (true, inode) - такие файлы читаются после них, смещения и inode не смешиваются
+    using Locality = std::pair<bool, uint64_t>;
+    Locality locality(const std::filesystem::path& path, uint64_t device, uint64_t inode);
+    // Ожидание свободного слота чтения устройства
+    Permit acquire(uint64_t device);
+
+private:
+    // Состояние устройства (создается при первом обращении и живет до конца работы планировщика)
+    DeviceState& state(uint64_t device);
+
+    DeviceLimits limits_;
+    std::mutex mutex_;
+    std::unordered_map<uint64_t, std::unique_ptr<DeviceState>> devices_;
+};
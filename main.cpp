@@ -1,126 +1,92 @@
 #include <iostream>
-#include <boost/crc.hpp> // библиотека для вычисления CRC32 (циклический избыточный код)
 #include <string>
 #include <vector>
 #include <filesystem> // библиотека boost для работы с файловой системой (предоставляет удобные функции для навигации по директориям и получения информации о файлах)
-#include <map> // для хэш-таблиц
-#include <algorithm>
+#include <memory>
+#include <chrono>
 #include <fstream>
-#include <regex> // регулярные выражения для обработки строк
-#include <set>
+#include <atomic>
+#include <iomanip>
+#include <csignal>
+#include <boost/program_options.hpp> // разбор аргументов командной строки
+#include "duplicate_finder.h" // движок поиска дубликатов
+#include "result_sink.h" // потоковый вывод групп дубликатов
+#include "scan_metrics.h" // счетчики и время этапов поиска
+#include "change_watcher.h" // уведомления об изменениях в директориях
+#include "partial_index.h" // частичные индексы распределенного поиска
+#if defined(_WIN32)
+#include <cstdlib>
+#else
+#include <unistd.h>
+#endif
 
 namespace fs = std::filesystem;
+namespace po = boost::program_options;
 
-// Функция для вычисления CRC32
-uint32_t calculateCRC32(const std::string& data) {
-    boost::crc_32_type crc;
-    crc.process_bytes(data.data(), data.size()); // обработка байтов строки
-    return crc.checksum(); // хэш
-}
+// Параметры программы: параметры поиска и вывода
+struct Settings {
+    FinderConfig finder; // параметры поиска дубликатов
+    std::string format = "text"; // формат вывода результатов
+    bool progress = false; // выводить ход поиска и итоговую сводку в stderr
+    fs::path metricsPath; // файл для итоговых счетчиков в формате JSON ("-" - stderr, пустой путь - не записываются)
+    bool watch = false; // после первого поиска следить за изменениями и обновлять список групп
+    fs::path indexPath; // записать частичный индекс этого узла вместо поиска групп (распределенный поиск)
+    fs::path indexSizesPath; // список размеров из слияния индексов размеров: индекс хэшей только для файлов этих размеров
+    std::string node; // имя узла в частичном индексе (по умолчанию имя компьютера)
+    std::vector<fs::path> mergePaths; // частичные индексы для слияния
+    double similarPercent = 0; // искать файлы, общие участки которых составляют не меньше этой доли (0 - обычный поиск дубликатов)
+    size_t chunkSize = 8192; // средний размер участка при поиске похожих файлов
+    size_t memoryLimit = 0; // бюджет памяти в МиБ (0 - без ограничения)
+    double readLimit = 0; // наибольшая скорость чтения в МиБ/с (0 - без ограничения)
+};
 
-// Функция для чтения файла и получения последовательности хэшей
-std::vector<uint32_t> readFile(const fs::path& filePath, size_t blockSize) {
-    std::vector<uint32_t> hashSequence; // вектор последовательности хэшей
-    std::ifstream file(filePath, std::ios::binary); // открытие файла в бинарном режиме
-    if (!file) { // если файл не открывается
-        throw std::runtime_error("Cannot open file: " + filePath.string());
-    }
-    std::string buffer(blockSize, '\0'); // буфер для чтения блоков
-    while (file.read(&buffer[0], blockSize) || file.gcount() > 0) { // чтение данных из файла блоками
-        size_t bytesRead = static_cast<size_t>(file.gcount()); // количество прочитанных байтов
-        buffer.resize(bytesRead); // обновление размера буфера до количества прочитанных байтов
-        if (bytesRead < blockSize) { // если прочитано меньше байтов, чем размер блока
-            buffer.resize(blockSize, '\0'); // дополнение буфера нулями до полного размера блока
-        }
-        uint32_t hash = calculateCRC32(buffer); // вычисление CRC32-хэша блока
-        hashSequence.push_back(hash); // добавление хэша в вектор хэшей
-    }
-    return hashSequence; // возвращение вектора хэшей после завершения чтения файла
+// Функция для вывода оценки дедупликации по участкам
+void reportChunks(const ChunkSummary& summary) {
+    const double mib = 1024.0 * 1024.0;
+    const uint64_t saved = summary.totalBytes - summary.uniqueBytes;
+    std::cerr << std::fixed << std::setprecision(1) << "Chunk deduplication: " << summary.totalBytes / mib << " MiB in " << summary.chunks << " chunks, "
+              << summary.uniqueBytes / mib << " MiB in " << summary.uniqueChunks << " unique chunks, saves " << saved / mib << " MiB ("
+              << (summary.totalBytes > 0 ? 100.0 * saved / summary.totalBytes : 0.0) << "%)" << std::endl;
 }
 
-// Функция для сравнения двух файлов по их хэшам
-bool compareHashes(const std::vector<uint32_t>& hashes1, const std::vector<uint32_t>& hashes2) {
-    if (hashes1.size() != hashes2.size()) return false; // размеры векторов разные => файлы разные
-    for (size_t i = 0; i < hashes1.size(); ++i) { // перебор элементов векторов
-        if (hashes1[i] != hashes2[i]) return false; // хотя бы один хэш не совпадает => файлы разные
-    }
-    return true; // файлы идентичны
+// Функция для получения имени компьютера (имя узла частичного индекса по умолчанию)
+std::string hostName() {
+#if defined(_WIN32)
+    const char* name = std::getenv("COMPUTERNAME");
+    return name != nullptr ? name : "";
+#else
+    char name[256] = {};
+    return ::gethostname(name, sizeof(name) - 1) == 0 ? name : "";
+#endif
 }
 
-// Функция для обработки файла
-void processFile(const fs::directory_entry& entry, const std::vector<fs::path>& exclusions, size_t minSize, const std::regex& maskRegex, size_t blockSize, std::map<fs::path, std::vector<uint32_t>>& allFiles) {
-    if (entry.is_regular_file()) { // является ли элемент обычным файлом
-        if (std::find(exclusions.begin(), exclusions.end(), entry.path().parent_path()) != exclusions.end()) { // если родительская директория файла в списке исключений
-            return;
-        }
-        if (entry.file_size() < minSize) { // если размер файла меньше минимального размера
-            return;
-        }
-        if (!std::regex_match(entry.path().filename().string(), maskRegex)) { // если имя файла не подходит к маске
-            return;
-        }
-        auto hashes = readFile(entry.path(), blockSize); // вычисление хэшей файла
-        allFiles[entry.path()] = hashes;
-    }
+std::atomic<bool> stopRequested{false}; // получен сигнал завершения режима наблюдения
+
+// Функция-обработчик SIGINT и SIGTERM: наблюдение завершается после текущего поиска
+extern "C" void requestStop(int) {
+    stopRequested.store(true);
 }
 
-// Функция для поиска дубликатов
-void findDuplicates(const std::vector<fs::path>& directories, const std::vector<fs::path>& exclusions, size_t blockSize, size_t minSize, std::regex& maskRegex, int scanLevel) {
-    std::map<std::string, std::set<fs::path>> duplicates; // словарь для хранения путей к дубликатам по их хэшам
-    std::map<fs::path, std::vector<uint32_t>> allFiles; // вектор пар для хранения путей к файлам и их хэшей
-    for (const auto& dir : directories) { // перебор директорий
-        if (!fs::exists(dir) || !fs::is_directory(dir)) { // если директории не существует или не является директорий
-            std::cerr << "Directory doesn't exist or isn't a directory: " << dir << std::endl;
-            continue;
-        }
-        if (scanLevel == 0) { // только указанная директория без вложенных
-            for (const auto& entry : fs::directory_iterator(dir)) { // итератор, который перебирает только файлы в указанной директории без вложенных
-                processFile(entry, exclusions, minSize, maskRegex, blockSize, allFiles); // обработка файла
-            }
-        } else { // сканирование с вложенными
-            for (const auto& entry : fs::recursive_directory_iterator(dir)) { // итератор, который перебирает все файлы и поддиректории
-                processFile(entry, exclusions, minSize, maskRegex, blockSize, allFiles); // обработка файла
-            }
-        }
-    }
-    // Сравнение хешей и добавление дубликатов в duplicates
-    for (auto it1 = allFiles.begin(); it1 != allFiles.end(); ++it1) {
-        for (auto it2 = std::next(it1); it2 != allFiles.end(); ++it2) {
-            if (compareHashes(it1->second, it2->second)) { // если хэши файлов равны
-                std::string hashKey(reinterpret_cast<const char*>(it1->second.data()), it1->second.size() * sizeof(uint32_t)); // последовательность байтов из вектора хэшей
-                // Добавление путей к дубликатам
-                duplicates[hashKey].insert(it1->first); // путь к файлу из первого итератора
-                duplicates[hashKey].insert(it2->first); // путь к файлу из второго итератора
-            }
-        }
+constexpr std::chrono::milliseconds progressInterval(1000); // период вывода хода поиска
+
+// Функция для вывода итоговых счетчиков поиска
+void reportMetrics(const Settings& settings, const ScanMetrics& metrics) {
+    if (settings.progress) {
+        metrics.writeSummary(std::cerr);
     }
-    // Вывод результатов
-    for (const auto& duplicate : duplicates) {
-        std::cout << std::endl;
-        for (const auto& file : duplicate.second) {
-            std::cout << file << std::endl;
+    if (settings.metricsPath == "-") {
+        metrics.writeJson(std::cerr);
+    } else if (!settings.metricsPath.empty()) {
+        std::ofstream out(settings.metricsPath, std::ios::trunc);
+        metrics.writeJson(out);
+        if (!out) {
+            throw std::runtime_error("Cannot write metrics file: " + settings.metricsPath.string());
         }
     }
 }
 
-// Функция для обработки маски и создания регулярного выражения
-std::regex createMaskRegex(const std::string& maskString) {
-    std::string modifiedMask = maskString; // регулярное выражение
-    // Преобразование маски в регулярное выражение
-    std::regex star_regex("\\*");
-    std::regex question_regex("\\?");
-    modifiedMask = "^" + std::regex_replace(modifiedMask, star_regex, ".*"); // замена "*" на ".*"
-    modifiedMask = std::regex_replace(modifiedMask, question_regex, "."); // замена "?" на "."
-    modifiedMask += "$"; // добавление конца строки
-    return std::regex(modifiedMask, std::regex_constants::icase); // игнорируем регистр
-}
-
-int main() {
-    std::vector<fs::path> directories; // вектор с путями до директорий
-    std::vector<fs::path> exclusions; // вектор с путями исключенных директорий
-    size_t blockSize; // размер блока 
-    size_t minSize = 1; // минимальный размер файла
-    int scanLevel; // уровень сканирования (0 - без вложенных директорий, 1 - со вложенными)
+// Функция для чтения параметров в диалоговом режиме (если программа запущена без аргументов)
+void readSettingsInteractively(Settings& settings) {
     int numberDirs; // количество директорий для сканирования
     std::cout << "Enter the number of directories to scan: ";
     std::cin >> numberDirs;
@@ -128,7 +94,7 @@ int main() {
         fs::path dir; // путь до директории
         std::cout << "Enter the path to the directory " << (i + 1) << ": ";
         std::cin >> dir;
-        directories.push_back(dir);
+        settings.finder.directories.push_back(dir);
     }
     int numberExclusions; // количество директорий для исключения
     std::cout << "Enter the number of directories to exclude: ";
@@ -137,16 +103,199 @@ int main() {
         fs::path excludedDir; // путь до исключенной директории
         std::cout << "Enter the path to the directory " << (i + 1) << " to exclude: ";
         std::cin >> excludedDir;
-        exclusions.push_back(excludedDir);
+        settings.finder.exclusions.push_back(excludedDir);
     }
-    std::cout << "Enter the scan level (0 - only the specified directory without nested ones, 1 - with attachments): ";
-    std::cin >> scanLevel;
-    std::string maskString; // маска в строковом виде
+    std::cout << "Enter the scan level (0 - only the specified directory without nested ones, N - up to N levels of nested directories, -1 - all nested directories): ";
+    std::cin >> settings.finder.scanLevel;
     std::cout << "Enter a file name mask for comparison (for example, *.txt or file?.txt): ";
-    std::cin >> maskString;
-    std::regex maskRegex = createMaskRegex(maskString); // преобразование маски в регулярное выражение
+    std::cin >> settings.finder.masks.front();
     std::cout << "Enter the block size (recommended value is 4096): ";
-    std::cin >> blockSize;
-    findDuplicates(directories, exclusions, blockSize, minSize, maskRegex, scanLevel);
+    std::cin >> settings.finder.blockSize;
+}
+
+// Функция для разбора аргументов командной строки; возвращает false, если программу нужно завершить с кодом exitCode
+bool parseCommandLine(int argc, char* argv[], Settings& settings, int& exitCode) {
+    po::options_description options("Usage: lab07 [options] [directory...]\nOptions");
+    options.add_options()
+        ("help,h", "show this help message")
+        ("dir,d", po::value<std::vector<fs::path>>(&settings.finder.directories)->composing(), "directory to scan (may be repeated)")
+        ("exclude,e", po::value<std::vector<fs::path>>(&settings.finder.exclusions)->composing(), "directory to exclude (may be repeated)")
+        ("level,l", po::value<int>(&settings.finder.scanLevel)->default_value(settings.finder.scanLevel), "scan depth: 0 - only the specified directories, N - up to N levels of nested directories, -1 - unlimited")
+        ("mask,m", po::value<std::vector<std::string>>(&settings.finder.masks)->composing(), "file name mask, e.g. *.txt, file?.txt or [a-c]*.jpg (may be repeated, default *)")
+        ("exclude-mask,x", po::value<std::vector<std::string>>(&settings.finder.excludeMasks)->composing(), "file name mask to skip (may be repeated)")
+        ("case-sensitive", po::bool_switch(&settings.finder.caseSensitive), "match masks case-sensitively")
+        ("block-size,b", po::value<size_t>(&settings.finder.blockSize)->default_value(settings.finder.blockSize), "block size in bytes (adaptive strategy: size of the head and tail blocks)")
+        ("strategy", po::value<std::string>()->default_value(blockStrategyName(settings.finder.strategy)), "block strategy: adaptive (head, tail, then growing blocks) or fixed (equal blocks of --block-size)")
+        ("min-size,s", po::value<size_t>(&settings.finder.minSize)->default_value(settings.finder.minSize), "minimum file size in bytes")
+        ("hash,a", po::value<std::string>()->default_value(hashAlgorithmName(settings.finder.algorithm)), "block hash algorithm: crc32, crc32c or xxh64")
+        ("threads,j", po::value<size_t>(&settings.finder.threadCount)->default_value(settings.finder.threadCount), "number of hashing threads (0 - one per CPU core)")
+        ("format,f", po::value<std::string>(&settings.format)->default_value(settings.format), "output format: text, jsonl (JSON Lines, also lists hardlink sets) or nul (NUL-separated paths, groups end with an extra NUL)")
+        ("verify", po::value<std::string>()->default_value(verifyModeName(settings.finder.verify)), "confirm groups found by block hashes: none, sha256 (SHA-256 of whole files) or bytes (byte-by-byte comparison)")
+        ("io", po::value<std::string>()->default_value("auto"), "first block reads: auto (io_uring when the kernel supports it) or threads")
+        ("page-cache", po::value<std::string>()->default_value(cacheModeName(settings.finder.cacheMode)), "page cache use: keep, drop (evict the pages the scan brought in as soon as they are hashed) or direct (O_DIRECT reads that bypass the cache)")
+        ("hdd-reads", po::value<size_t>(&settings.finder.deviceReads.rotational)->default_value(settings.finder.deviceReads.rotational), "maximum concurrent reads from one rotational disk (files are read in on-disk order)")
+        ("ssd-reads", po::value<size_t>(&settings.finder.deviceReads.solidState)->default_value(settings.finder.deviceReads.solidState), "maximum concurrent reads from one SSD or device of unknown type")
+        ("memory-limit", po::value<size_t>(&settings.memoryLimit), "memory budget in MiB for candidate tables and hash sequences: beyond it candidates are spilled to sorted temporary files and compared in batches of sizes")
+        ("spill-dir", po::value<fs::path>(&settings.finder.resources.spillDirectory), "directory for the temporary files of --memory-limit (default: the system temporary directory)")
+        ("read-limit", po::value<double>(&settings.readLimit), "maximum average read rate in MiB/s")
+        ("idle-io", po::bool_switch(&settings.finder.resources.idleIo), "read with the idle I/O priority: the disk is used only when no other program needs it (Linux)")
+        ("cache", po::value<fs::path>(&settings.finder.cachePath), "persistent hash cache file")
+        ("snapshot", po::value<fs::path>(&settings.finder.snapshotPath), "snapshot file for incremental rescans: only changed directories are re-read and only new or changed files re-hashed")
+        ("watch", po::bool_switch(&settings.watch), "keep running after the scan: watch the scanned directories for changes and print the updated list of groups after each change (until SIGINT or SIGTERM)")
+        ("partial-index", po::value<fs::path>(&settings.indexPath), "distributed scan: write this node's partial index to a file instead of printing groups (sizes only, or block hashes with --index-sizes)")
+        ("index-sizes", po::value<fs::path>(&settings.indexSizesPath), "size list printed by merging the size indexes of all nodes: index only files of these sizes, with the hashes of all blocks")
+        ("node", po::value<std::string>(&settings.node), "node name stored in the partial index and prefixed to its paths in merged groups (default: host name)")
+        ("merge", po::value<std::vector<fs::path>>(&settings.mergePaths)->multitoken(), "merge partial indexes of all nodes: size indexes give the list of sizes found more than once, hash indexes give the duplicate groups")
+        ("similar", po::value<double>(&settings.similarPercent), "find partial duplicates instead: pairs of files sharing at least this percentage of content in content-defined chunks, plus a chunk-level deduplication estimate")
+        ("chunk-size", po::value<size_t>(&settings.chunkSize)->default_value(settings.chunkSize), "average chunk size for --similar (power of two; chunks are 1/4 to 8 times this size)")
+        ("progress", po::bool_switch(&settings.progress), "print progress to stderr every second and a summary of counters and stage times at the end")
+        ("metrics", po::value<fs::path>(&settings.metricsPath), "write counters and stage times as one JSON line to this file (- for stderr)");
+    po::positional_options_description positional;
+    positional.add("dir", -1); // аргументы без имени считаются директориями
+    po::variables_map variables;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(options).positional(positional).run(), variables);
+        po::notify(variables);
+    } catch (const po::error& error) {
+        std::cerr << error.what() << std::endl << options << std::endl;
+        exitCode = 1;
+        return false;
+    }
+    if (variables.count("help")) {
+        std::cout << options << std::endl;
+        exitCode = 0;
+        return false;
+    }
+    std::string error; // описание первого неверного параметра
+    if (settings.finder.directories.empty() && settings.mergePaths.empty()) {
+        error = "No directories to scan";
+    } else if (settings.finder.blockSize == 0) {
+        error = "Block size must be positive";
+    } else if (settings.finder.blockSize > UINT32_MAX) {
+        error = "Block size is too large";
+    } else if (!parseBlockStrategy(variables["strategy"].as<std::string>(), settings.finder.strategy)) {
+        error = "Unknown block strategy: " + variables["strategy"].as<std::string>();
+    } else if (!parseHashAlgorithm(variables["hash"].as<std::string>(), settings.finder.algorithm)) {
+        error = "Unknown hash algorithm: " + variables["hash"].as<std::string>();
+    } else if (!parseVerifyMode(variables["verify"].as<std::string>(), settings.finder.verify)) {
+        error = "Unknown verification mode: " + variables["verify"].as<std::string>();
+    } else if (variables["io"].as<std::string>() != "auto" && variables["io"].as<std::string>() != "threads") {
+        error = "Unknown I/O engine: " + variables["io"].as<std::string>();
+    } else if (!parseCacheMode(variables["page-cache"].as<std::string>(), settings.finder.cacheMode)) {
+        error = "Unknown page cache mode: " + variables["page-cache"].as<std::string>();
+    } else if (settings.finder.deviceReads.rotational == 0 || settings.finder.deviceReads.solidState == 0) {
+        error = "Concurrent reads per device must be positive";
+    } else if (variables.count("memory-limit") && (settings.memoryLimit == 0 || settings.memoryLimit > SIZE_MAX / (1024 * 1024))) {
+        error = "--memory-limit must be a positive number of MiB";
+    } else if (settings.memoryLimit > 0 && (!settings.finder.snapshotPath.empty() || settings.watch)) {
+        error = "--memory-limit cannot be combined with --snapshot or --watch";
+    } else if (variables.count("read-limit") && !(settings.readLimit > 0 && settings.readLimit * 1024 * 1024 < 1e18)) {
+        error = "--read-limit must be a positive rate in MiB/s";
+    } else if (!createResultSink(settings.format, std::cout)) {
+        error = "Unknown output format: " + settings.format;
+    } else if (!settings.indexSizesPath.empty() && settings.indexPath.empty()) {
+        error = "--index-sizes needs --partial-index";
+    } else if ((!settings.indexPath.empty() || !settings.mergePaths.empty()) && settings.watch) {
+        error = "--watch cannot be combined with --partial-index or --merge";
+    } else if (!settings.indexPath.empty() && !settings.mergePaths.empty()) {
+        error = "--partial-index and --merge are separate steps";
+    } else if (variables.count("similar") && (settings.similarPercent <= 0 || settings.similarPercent > 100)) {
+        error = "--similar must be a percentage in (0, 100]";
+    } else if (variables.count("similar") && (settings.watch || !settings.indexPath.empty() || !settings.mergePaths.empty())) {
+        error = "--similar cannot be combined with --watch, --partial-index or --merge";
+    } else if (settings.chunkSize < 256 || settings.chunkSize > (1u << 24) || (settings.chunkSize & (settings.chunkSize - 1)) != 0) {
+        error = "Chunk size must be a power of two from 256 to 16777216";
+    }
+    settings.finder.asyncIo = variables["io"].as<std::string>() == "auto";
+    settings.finder.incremental = settings.watch; // повторные поиски читают только изменившиеся директории
+    settings.finder.resources.memoryBytes = settings.memoryLimit * 1024 * 1024;
+    settings.finder.resources.readBytesPerSecond = static_cast<uint64_t>(settings.readLimit * 1024 * 1024);
+    if (!error.empty()) {
+        std::cerr << error << std::endl << options << std::endl;
+        exitCode = 1;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Settings settings; // параметры поиска
+    if (argc > 1) {
+        int exitCode = 0;
+        if (!parseCommandLine(argc, argv, settings, exitCode)) {
+            return exitCode;
+        }
+    } else {
+        readSettingsInteractively(settings);
+    }
+    try {
+        std::unique_ptr<ResultSink> sink = createResultSink(settings.format, std::cout); // вывод групп по мере их подтверждения
+        if (!settings.mergePaths.empty()) { // слияние частичных индексов узлов: список размеров или группы дубликатов
+            mergePartialIndexes(settings.mergePaths, [](uint64_t size) { std::cout << size << '\n'; }, [&sink](const DuplicateGroup& group) { sink->write(group); });
+            sink->finish();
+            std::cout << std::flush;
+            return 0;
+        }
+        DuplicateFinder finder(settings.finder);
+        if (!settings.indexPath.empty()) { // частичный индекс этого узла
+            std::vector<uint64_t> sizes;
+            if (!settings.indexSizesPath.empty()) {
+                sizes = readSizeList(settings.indexSizesPath);
+            }
+            finder.writeIndex(settings.indexPath, settings.node.empty() ? hostName() : settings.node, settings.indexSizesPath.empty() ? nullptr : &sizes);
+            reportMetrics(settings, finder.metrics());
+            return 0;
+        }
+        if (settings.similarPercent > 0) { // поиск частичных дубликатов
+            ChunkingParams chunking;
+            chunking.averageSize = settings.chunkSize;
+            chunking.minSize = settings.chunkSize / 4;
+            chunking.maxSize = settings.chunkSize * 8;
+            ChunkSummary summary = finder.findSimilar(settings.similarPercent / 100.0, chunking, [&sink](const SimilarFiles& pair) { sink->write(pair); });
+            sink->finish();
+            reportChunks(summary);
+            reportMetrics(settings, finder.metrics());
+            return 0;
+        }
+        auto scan = [&] { // полный список групп; в режиме наблюдения - после каждого изменения
+            std::unique_ptr<ProgressReporter> progress;
+            if (settings.progress) {
+                progress = std::make_unique<ProgressReporter>(finder.metrics(), std::cerr, progressInterval);
+            }
+            finder.run(*sink);
+            sink->finish();
+        };
+        scan();
+        if (settings.watch) {
+            std::signal(SIGINT, requestStop);
+            std::signal(SIGTERM, requestStop);
+            ChangeWatcher watcher;
+            watcher.watch(finder.scannedDirectories());
+            std::cerr << "Watching " << watcher.watchedCount() << " directories for changes" << std::endl;
+            std::vector<fs::path> changed; // директории, изменившиеся после прошлого поиска
+            while (watcher.wait(changed, stopRequested)) {
+                finder.invalidate(changed);
+                if (settings.progress) {
+                    if (changed.empty()) { // часть директорий не наблюдается: периодическая проверка
+                        std::cerr << "Checking all directories for changes" << std::endl;
+                    } else {
+                        std::cerr << "Rescanning after changes in " << changed.size() << " directories" << std::endl;
+                    }
+                }
+                try {
+                    scan();
+                } catch (const std::exception& error) { // ошибка одного повторного поиска не завершает наблюдение
+                    sink->finish(); // уже найденные группы прерванного поиска не смешиваются со следующим списком
+                    std::cerr << error.what() << ", rescanning after the next change" << std::endl;
+                    continue; // прерванный поиск не оставил снимка: следующий прочитает все директории, наблюдаемые остаются прежними
+                }
+                watcher.watch(finder.scannedDirectories()); // новые директории начинают наблюдаться, удаленные - перестают
+            }
+        }
+        reportMetrics(settings, finder.metrics());
+    } catch (const std::exception& error) { // например, файл нельзя открыть
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,208 @@
+#include "partial_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char indexMagic[4] = {'L', '7', 'P', 'I'};
+constexpr uint32_t indexVersion = 1; // версия формата, увеличивается при любом его изменении
+
+// Функция для сравнения ключей записей (размер и хэши): записи с равными ключами - одинаковые файлы
+bool keyLess(const IndexEntry& left, const IndexEntry& right) {
+    return std::tie(left.size, left.hashes) < std::tie(right.size, right.hashes);
+}
+
+bool sameKey(const IndexEntry& left, const IndexEntry& right) {
+    return left.size == right.size && left.hashes == right.hashes;
+}
+
+template <typename T>
+void writeValue(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void writeString(std::ostream& out, const std::string& text) {
+    writeValue<uint64_t>(out, text.size());
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+} // namespace
+
+bool indexEntryLess(const IndexEntry& left, const IndexEntry& right) {
+    return std::tie(left.size, left.hashes, left.path) < std::tie(right.size, right.hashes, right.path);
+}
+
+PartialIndexWriter::PartialIndexWriter(const fs::path& indexPath, const IndexHeader& header) : path_(indexPath), out_(indexPath, std::ios::binary | std::ios::trunc) {
+    if (!out_) {
+        throw std::runtime_error("Cannot create partial index: " + indexPath.string());
+    }
+    out_.write(indexMagic, sizeof(indexMagic));
+    writeValue(out_, indexVersion);
+    writeString(out_, header.node);
+    writeString(out_, header.layout);
+    writeValue<uint8_t>(out_, header.hashed ? 1 : 0);
+}
+
+void PartialIndexWriter::write(const IndexEntry& entry) {
+    writeValue(out_, entry.size);
+    writeValue(out_, entry.device);
+    writeValue(out_, entry.inode);
+    writeValue<uint32_t>(out_, static_cast<uint32_t>(entry.hashes.size()));
+    out_.write(reinterpret_cast<const char*>(entry.hashes.data()), static_cast<std::streamsize>(entry.hashes.size() * sizeof(uint32_t)));
+    writeString(out_, entry.path);
+}
+
+void PartialIndexWriter::finish() {
+    if (!out_.flush()) {
+        throw std::runtime_error("Cannot write partial index: " + path_.string());
+    }
+}
+
+PartialIndexReader::PartialIndexReader(const fs::path& indexPath) : path_(indexPath), in_(indexPath, std::ios::binary) {
+    std::error_code error;
+    remaining_ = fs::file_size(indexPath, error);
+    if (error || !in_) {
+        throw std::runtime_error("Cannot open partial index: " + indexPath.string());
+    }
+    char magic[4];
+    uint32_t version = 0;
+    uint8_t hashed = 0;
+    if (!bytes(magic, sizeof(magic)) || !bytes(&version, sizeof(version)) || std::memcmp(magic, indexMagic, sizeof(magic)) != 0 || version != indexVersion) {
+        throw std::runtime_error("Not a partial index of this version: " + indexPath.string());
+    }
+    if (!string(header_.node) || !string(header_.layout) || !bytes(&hashed, sizeof(hashed))) {
+        throw std::runtime_error("Invalid partial index: " + indexPath.string());
+    }
+    header_.hashed = hashed != 0;
+}
+
+bool PartialIndexReader::bytes(void* data, uint64_t size) {
+    if (size > remaining_ || !in_.read(static_cast<char*>(data), static_cast<std::streamsize>(size))) {
+        return false;
+    }
+    remaining_ -= size;
+    return true;
+}
+
+bool PartialIndexReader::string(std::string& text) {
+    uint64_t length = 0;
+    if (!bytes(&length, sizeof(length)) || length > remaining_) {
+        return false;
+    }
+    text.resize(static_cast<size_t>(length));
+    return bytes(&text[0], length);
+}
+
+bool PartialIndexReader::next(IndexEntry& entry) {
+    if (remaining_ == 0) {
+        return false;
+    }
+    uint32_t hashCount = 0;
+    bool valid = bytes(&entry.size, sizeof(entry.size)) && bytes(&entry.device, sizeof(entry.device)) && bytes(&entry.inode, sizeof(entry.inode)) &&
+                 bytes(&hashCount, sizeof(hashCount)) && hashCount * sizeof(uint32_t) <= remaining_;
+    if (valid) {
+        entry.hashes.resize(hashCount);
+        valid = bytes(entry.hashes.data(), hashCount * sizeof(uint32_t)) && string(entry.path);
+    }
+    if (!valid) {
+        throw std::runtime_error("Invalid partial index: " + path_.string());
+    }
+    return true;
+}
+
+void mergePartialIndexes(const std::vector<fs::path>& indexPaths, const std::function<void(uint64_t size)>& onSize, const GroupCallback& onGroup) {
+    std::vector<std::unique_ptr<PartialIndexReader>> readers;
+    for (const auto& indexPath : indexPaths) {
+        readers.push_back(std::make_unique<PartialIndexReader>(indexPath));
+        const IndexHeader& header = readers.back()->header();
+        if (header.hashed != readers.front()->header().hashed || header.layout != readers.front()->header().layout) {
+            throw std::runtime_error("Partial index was made in another pass or with other block settings: " + indexPath.string());
+        }
+    }
+    if (readers.empty()) {
+        return;
+    }
+    const bool hashed = readers.front()->header().hashed;
+    // Куча текущих записей всех индексов: наверху запись с наименьшим ключом (при равных - из индекса с меньшим номером)
+    std::vector<IndexEntry> current(readers.size());
+    auto greater = [&current](size_t left, size_t right) {
+        if (keyLess(current[right], current[left])) {
+            return true;
+        }
+        return !keyLess(current[left], current[right]) && right < left;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+    for (size_t i = 0; i < readers.size(); ++i) {
+        if (readers[i]->next(current[i])) {
+            heap.push(i);
+        }
+    }
+    std::vector<std::pair<size_t, IndexEntry>> run; // записи с одинаковым ключом из всех индексов
+    while (!heap.empty()) {
+        run.clear();
+        do {
+            size_t reader = heap.top();
+            heap.pop();
+            run.emplace_back(reader, current[reader]);
+            if (readers[reader]->next(current[reader])) {
+                if (keyLess(current[reader], run.back().second)) {
+                    throw std::runtime_error("Partial index is not sorted: " + indexPaths[reader].string());
+                }
+                heap.push(reader);
+            }
+        } while (!heap.empty() && sameKey(current[heap.top()], run.front().second));
+        if (run.size() < 2) { // один путь - ни копий, ни жестких ссылок
+            continue;
+        }
+        if (!hashed) {
+            onSize(run.front().second.size);
+            continue;
+        }
+        // Пути с общими узлом, устройством и inode - жесткие ссылки на один файл
+        std::map<std::tuple<size_t, uint64_t, uint64_t, std::string>, std::vector<fs::path>> files;
+        for (const auto& item : run) {
+            const IndexEntry& entry = item.second;
+            const std::string& node = readers[item.first]->header().node;
+            fs::path path = fs::u8path(node.empty() ? entry.path : node + ":" + entry.path);
+            files[std::make_tuple(item.first, entry.device, entry.inode, entry.inode == 0 ? entry.path : std::string())].push_back(std::move(path));
+        }
+        DuplicateGroup group;
+        group.fileSize = run.front().second.size;
+        for (auto& file : files) {
+            group.files.insert(group.files.end(), file.second.begin(), file.second.end());
+            if (file.second.size() > 1) {
+                std::sort(file.second.begin(), file.second.end());
+                group.hardlinks.push_back(std::move(file.second));
+            }
+        }
+        std::sort(group.files.begin(), group.files.end());
+        std::sort(group.hardlinks.begin(), group.hardlinks.end());
+        onGroup(group);
+    }
+}
+
+std::vector<uint64_t> readSizeList(const fs::path& listPath) {
+    std::ifstream in(listPath);
+    if (!in) {
+        throw std::runtime_error("Cannot open size list: " + listPath.string());
+    }
+    std::vector<uint64_t> sizes;
+    uint64_t size = 0;
+    while (in >> size) {
+        sizes.push_back(size);
+    }
+    if (!in.eof()) {
+        throw std::runtime_error("Invalid size list: " + listPath.string());
+    }
+    std::sort(sizes.begin(), sizes.end());
+    sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+    return sizes;
+}
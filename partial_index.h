@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "result_sink.h"
+
+// Частичные индексы для распределенного поиска: каждый узел обходит свои директории и записывает отсортированный индекс,
+// индексы всех узлов объединяются потоковым k-путевым слиянием. Поиск идет в два прохода:
+// 1) индексы размеров (файлы не читаются), их слияние дает размеры, которые встречаются больше одного раза на всех узлах;
+// 2) индексы хэшей только для файлов этих размеров (полные последовательности хэшей блоков), их слияние дает группы дубликатов.
+// Формат файла (порядок байтов узла): заголовок {"L7PI", версия, имя узла, параметры хэширования, признак хэшей},
+// затем записи {размер, устройство, inode, количество хэшей, хэши, путь в UTF-8}, отсортированные по (размер, хэши, путь)
+
+// Запись частичного индекса
+struct IndexEntry {
+    uint64_t size = 0; // размер файла
+    uint64_t device = 0; // устройство на своем узле
+    uint64_t inode = 0; // inode на своем узле (0 - неизвестен)
+    std::vector<uint32_t> hashes; // хэши всех блоков файла (пусто в индексе размеров)
+    std::string path; // путь на своем узле в UTF-8
+};
+
+// Заголовок частичного индекса
+struct IndexHeader {
+    std::string node; // имя узла (добавляется к путям в группах: "узел:путь")
+    std::string layout; // разбиение на блоки и хэш-функция: хэши индексов с разными параметрами не сравниваются
+    bool hashed = false; // записи содержат хэши (второй проход)
+};
+
+// Порядок записей в индексе: по размеру, затем по хэшам, затем по пути
+bool indexEntryLess(const IndexEntry& left, const IndexEntry& right);
+
+// Последовательная запись частичного индекса; записи передаются в порядке indexEntryLess
+class PartialIndexWriter {
+public:
+    PartialIndexWriter(const std::filesystem::path& indexPath, const IndexHeader& header);
+
+    void write(const IndexEntry& entry);
+    // Проверка, что все записи дошли до файла
+    void finish();
+
+private:
+    std::filesystem::path path_;
+    std::ofstream out_;
+};
+
+// Потоковое чтение частичного индекса (в памяти только текущая запись)
+class PartialIndexReader {
+public:
+    explicit PartialIndexReader(const std::filesystem::path& indexPath);
+
+    const IndexHeader& header() const { return header_; }
+    // Чтение следующей записи; false - записи закончились
+    bool next(IndexEntry& entry);
+
+private:
+    // Чтение с проверкой размеров по оставшейся длине файла (поврежденный индекс не вызывает больших выделений памяти)
+    bool bytes(void* data, uint64_t size);
+    bool string(std::string& text);
+
+    std::filesystem::path path_;
+    std::ifstream in_;
+    uint64_t remaining_ = 0; // непрочитанные байты файла
+    IndexHeader header_;
+};
+
+// Функция для слияния частичных индексов одного прохода. Для индексов размеров onSize получает по возрастанию размеры,
+// которые встречаются больше одного раза; для индексов хэшей onGroup получает группы дубликатов по возрастанию размера
+void mergePartialIndexes(const std::vector<std::filesystem::path>& indexPaths, const std::function<void(uint64_t size)>& onSize, const GroupCallback& onGroup);
+
+// Функция для чтения списка размеров (десятичные числа по одному в строке, как их выводит слияние индексов размеров)
+std::vector<uint64_t> readSizeList(const std::filesystem::path& listPath);
@@ -0,0 +1,51 @@
+#include "resource_governor.h"
+
+#include <algorithm>
+#include <thread>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#if defined(__linux__)
+// Константы ioprio_set из linux/ioprio.h (заголовка нет в старых пакетах заголовков ядра)
+constexpr int ioprioWhoProcess = 1; // who - поток (0 - вызывающий)
+constexpr int ioprioClassIdle = 3;
+constexpr int ioprioClassShift = 13;
+#endif
+
+} // namespace
+
+ReadThrottle::ReadThrottle(uint64_t bytesPerSecond, ShardedCounter* waitNanos)
+    : nanosPerByte_(1e9 / static_cast<double>(std::max<uint64_t>(bytesPerSecond, 1))), waitNanos_(waitNanos) {}
+
+void ReadThrottle::acquire(uint64_t bytes) {
+    if (bytes == 0) {
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    const auto cost = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::nano>(bytes * nanosPerByte_));
+    std::chrono::steady_clock::time_point wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        paidUntil_ = std::max(paidUntil_, now) + cost; // неиспользованные маркеры копятся не дольше burstTime
+        wake = paidUntil_ - burstTime;
+    }
+    if (wake > now) {
+        std::this_thread::sleep_until(wake);
+        if (waitNanos_ != nullptr) {
+            waitNanos_->add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - now).count()));
+        }
+    }
+}
+
+bool setIdleIoPriority() {
+#if defined(__linux__) && defined(SYS_ioprio_set)
+    return ::syscall(SYS_ioprio_set, ioprioWhoProcess, 0, ioprioClassIdle << ioprioClassShift) == 0;
+#else
+    return false;
+#endif
+}
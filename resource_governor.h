@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+
+#include "scan_metrics.h"
+
+// Ограничения ресурсов поиска, чтобы он мог работать рядом с чувствительными к задержкам программами
+struct ResourceLimits {
+    size_t memoryBytes = 0; // бюджет памяти таблиц кандидатов и последовательностей хэшей (0 - без ограничения)
+    uint64_t readBytesPerSecond = 0; // наибольшая средняя скорость чтения файлов (0 - без ограничения)
+    bool idleIo = false; // читать с приоритетом ввода-вывода idle: диск получают только тогда, когда он никому больше не нужен (Linux)
+    std::filesystem::path spillDirectory; // директория временных файлов кандидатов при превышении бюджета (пустой путь - временная директория ОС)
+};
+
+// Ограничение скорости чтения маркерным ведром: ведро пополняется со скоростью bytesPerSecond и вмещает burstTime чтений,
+// каждое чтение забирает из ведра столько маркеров, сколько байтов оно прочитает, и ждет, пока их наберется достаточно.
+// Чтение больше емкости ведра ждет пропорционально своему размеру, так что средняя скорость не превышает предела при любых размерах чтений
+class ReadThrottle {
+public:
+    // waitNanos - счетчик суммарного времени ожидания (nullptr - не ведется)
+    ReadThrottle(uint64_t bytesPerSecond, ShardedCounter* waitNanos = nullptr);
+
+    // Ожидание разрешения прочитать bytes байтов (потокобезопасно; потоки получают разрешения в порядке обращения)
+    void acquire(uint64_t bytes);
+
+    static constexpr std::chrono::milliseconds burstTime{100}; // емкость ведра: столько времени чтения на полной скорости без ожидания
+
+private:
+    double nanosPerByte_; // время пополнения ведра на один байт
+    ShardedCounter* waitNanos_;
+    std::mutex mutex_;
+    std::chrono::steady_clock::time_point paidUntil_; // момент, к которому ведро пополнится на все выданные разрешения
+};
+
+// Функция для перевода вызывающего потока в класс ввода-вывода idle (Linux, ioprio_set); потоки, созданные после вызова, наследуют приоритет.
+// Возвращает false, если ОС не поддерживает приоритеты ввода-вывода или отказала в изменении
+bool setIdleIoPriority();
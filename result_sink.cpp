@@ -0,0 +1,190 @@
+#include "result_sink.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Текстовый вывод: пустая строка перед группой, затем пути в кавычках по одному в строке (как operator<< для fs::path).
+// Жесткие ссылки выводятся как обычные пути группы, наборы ссылок сообщает только JSON Lines
+class TextSink : public ResultSink {
+public:
+    using ResultSink::ResultSink;
+
+protected:
+    void format(const DuplicateGroup& group, std::string& buffer) override {
+        buffer += '\n';
+        for (const auto& file : group.files) {
+            appendQuoted(file, buffer);
+        }
+    }
+
+    // Пара похожих файлов: пустая строка, доля и объем общих участков, затем оба пути
+    void format(const SimilarFiles& pair, std::string& buffer) override {
+        char share[64];
+        std::snprintf(share, sizeof(share), "%.1f%% shared, %llu bytes\n", 100.0 * pair.sharedBytes / std::max<uintmax_t>(pair.firstSize, 1),
+                      static_cast<unsigned long long>(pair.sharedBytes));
+        buffer += '\n';
+        buffer += share;
+        appendQuoted(pair.first, buffer);
+        appendQuoted(pair.second, buffer);
+    }
+
+private:
+    static void appendQuoted(const fs::path& file, std::string& buffer) {
+        buffer += '"';
+        for (char c : file.string()) {
+            if (c == '"' || c == '\\') {
+                buffer += '\\';
+            }
+            buffer += c;
+        }
+        buffer += "\"\n";
+    }
+};
+
+// JSON Lines: одна группа на строку, {"size":N,"files":["...",...]}; жесткие ссылки - в поле "hardlinks":[["...",...],...]
+class JsonLinesSink : public ResultSink {
+public:
+    using ResultSink::ResultSink;
+
+protected:
+    void format(const DuplicateGroup& group, std::string& buffer) override {
+        buffer += "{\"size\":";
+        buffer += std::to_string(group.fileSize);
+        buffer += ",\"files\":[";
+        for (size_t i = 0; i < group.files.size(); ++i) {
+            if (i > 0) {
+                buffer += ',';
+            }
+            appendJsonString(group.files[i].string(), buffer);
+        }
+        buffer += ']';
+        if (!group.hardlinks.empty()) {
+            buffer += ",\"hardlinks\":[";
+            for (size_t i = 0; i < group.hardlinks.size(); ++i) {
+                buffer += i > 0 ? ",[" : "[";
+                for (size_t j = 0; j < group.hardlinks[i].size(); ++j) {
+                    if (j > 0) {
+                        buffer += ',';
+                    }
+                    appendJsonString(group.hardlinks[i][j].string(), buffer);
+                }
+                buffer += ']';
+            }
+            buffer += ']';
+        }
+        buffer += "}\n";
+    }
+
+    // Пара похожих файлов: {"shared_bytes":N,"files":[{"path":"...","size":N},{"path":"...","size":N}]}
+    void format(const SimilarFiles& pair, std::string& buffer) override {
+        buffer += "{\"shared_bytes\":" + std::to_string(pair.sharedBytes) + ",\"files\":[{\"path\":";
+        appendJsonString(pair.first.string(), buffer);
+        buffer += ",\"size\":" + std::to_string(pair.firstSize) + "},{\"path\":";
+        appendJsonString(pair.second.string(), buffer);
+        buffer += ",\"size\":" + std::to_string(pair.secondSize) + "}]}\n";
+    }
+
+private:
+    static void appendJsonString(const std::string& value, std::string& buffer) {
+        buffer += '"';
+        for (unsigned char c : value) {
+            switch (c) {
+            case '"': buffer += "\\\""; break;
+            case '\\': buffer += "\\\\"; break;
+            case '\n': buffer += "\\n"; break;
+            case '\r': buffer += "\\r"; break;
+            case '\t': buffer += "\\t"; break;
+            default:
+                if (c < 0x20) { // остальные управляющие символы
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    buffer += escaped;
+                } else {
+                    buffer += static_cast<char>(c);
+                }
+            }
+        }
+        buffer += '"';
+    }
+};
+
+// Вывод с разделителем NUL: каждый путь завершается NUL, группа завершается дополнительным NUL
+class NulSink : public ResultSink {
+public:
+    using ResultSink::ResultSink;
+
+protected:
+    void format(const DuplicateGroup& group, std::string& buffer) override {
+        for (const auto& file : group.files) {
+            buffer += file.string();
+            buffer += '\0';
+        }
+        buffer += '\0';
+    }
+
+    // Пара похожих файлов - как группа из двух путей
+    void format(const SimilarFiles& pair, std::string& buffer) override {
+        buffer += pair.first.string();
+        buffer += '\0';
+        buffer += pair.second.string();
+        buffer += '\0';
+        buffer += '\0';
+    }
+};
+
+} // namespace
+
+void ResultSink::write(const DuplicateGroup& group) {
+    format(group, buffer_);
+    flushIfDue();
+}
+
+void ResultSink::write(const SimilarFiles& pair) {
+    format(pair, buffer_);
+    flushIfDue();
+}
+
+void ResultSink::flushIfDue() {
+    auto now = std::chrono::steady_clock::now();
+    if (buffer_.size() >= flushBytes || now - lastFlush_ >= std::chrono::seconds(1)) {
+        out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        out_.flush();
+        buffer_.clear();
+        lastFlush_ = now;
+    }
+}
+
+void ResultSink::finish() {
+    out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    out_.flush();
+    buffer_.clear();
+}
+
+std::unique_ptr<ResultSink> createResultSink(const std::string& format, std::ostream& out) {
+    if (format == "text") {
+        return std::make_unique<TextSink>(out);
+    }
+    if (format == "jsonl") {
+        return std::make_unique<JsonLinesSink>(out);
+    }
+    if (format == "nul") {
+        return std::make_unique<NulSink>(out);
+    }
+    return nullptr;
+}
+
+void OrderedResultWriter::complete(size_t task, std::vector<DuplicateGroup> groups) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_[task] = std::move(groups);
+    done_[task] = true;
+    for (; next_ < done_.size() && done_[next_]; ++next_) {
+        for (const auto& group : pending_[next_]) {
+            onGroup_(group);
+        }
+        std::vector<DuplicateGroup>().swap(pending_[next_]); // память выведенных групп освобождается сразу
+    }
+}
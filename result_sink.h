@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Группа файлов-дубликатов
+struct DuplicateGroup {
+    uintmax_t fileSize = 0; // размер каждого файла группы
+    std::vector<std::filesystem::path> files; // пути к файлам в порядке сортировки
+    std::vector<std::vector<std::filesystem::path>> hardlinks; // наборы путей группы, ссылающихся на один inode
+};
+
+// Пара файлов с общими участками содержимого (поиск частичных дубликатов)
+struct SimilarFiles {
+    std::filesystem::path first; // больший файл пары (при равных размерах - меньший путь)
+    std::filesystem::path second;
+    uintmax_t firstSize = 0;
+    uintmax_t secondSize = 0;
+    uint64_t sharedBytes = 0; // объем общих участков
+};
+
+// Получатель найденных групп дубликатов
+using GroupCallback = std::function<void(const DuplicateGroup& group)>;
+
+// Получатель результатов: группы выводятся сразу после подтверждения, вывод накапливается в буфере
+class ResultSink {
+public:
+    explicit ResultSink(std::ostream& out) : out_(out) {}
+    virtual ~ResultSink() = default;
+
+    // Вывод группы дубликатов
+    void write(const DuplicateGroup& group);
+    // Вывод пары похожих файлов
+    void write(const SimilarFiles& pair);
+    // Сброс буфера в поток после завершения поиска
+    void finish();
+
+protected:
+    // Форматирование группы в конец буфера
+    virtual void format(const DuplicateGroup& group, std::string& buffer) = 0;
+    virtual void format(const SimilarFiles& pair, std::string& buffer) = 0;
+
+private:
+    // Сброс буфера, если он вырос или давно не сбрасывался
+    void flushIfDue();
+
+    static constexpr size_t flushBytes = 64 * 1024; // размер буфера, после которого он сбрасывается в поток
+    std::ostream& out_;
+    std::string buffer_; // еще не выведенные данные
+    std::chrono::steady_clock::time_point lastFlush_ = std::chrono::steady_clock::now(); // сброс не реже раза в секунду, чтобы группы не задерживались
+};
+
+// Функция для создания получателя результатов по названию формата ("text", "jsonl", "nul"); для неизвестного формата возвращает nullptr
+std::unique_ptr<ResultSink> createResultSink(const std::string& format, std::ostream& out);
+
+// Вывод результатов параллельных задач в порядке их номеров: группы задачи выводятся, как только завершены все предыдущие задачи,
+// поэтому результат не зависит от количества потоков
+class OrderedResultWriter {
+public:
+    OrderedResultWriter(GroupCallback onGroup, size_t taskCount) : onGroup_(std::move(onGroup)), pending_(taskCount), done_(taskCount, false) {}
+
+    // Передача групп, найденных задачей с номером task (потокобезопасно)
+    void complete(size_t task, std::vector<DuplicateGroup> groups);
+
+private:
+    GroupCallback onGroup_; // получатель групп (вызывается под блокировкой, поэтому никогда одновременно)
+    std::mutex mutex_;
+    std::vector<std::vector<DuplicateGroup>> pending_; // результаты завершенных задач, ожидающие предыдущих
+    std::vector<bool> done_; // завершенные задачи
+    size_t next_ = 0; // номер первой невыведенной задачи
+};
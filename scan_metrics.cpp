@@ -0,0 +1,124 @@
+#include "scan_metrics.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+constexpr double nanosPerMilli = 1e6;
+constexpr double bytesPerMiB = 1024.0 * 1024.0;
+
+// Время с начала поиска в миллисекундах
+double elapsedMillis(const ScanMetrics& metrics) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - metrics.start).count();
+}
+
+} // namespace
+
+uint64_t ShardedCounter::load() const {
+    uint64_t sum = 0;
+    for (const auto& cell : cells_) {
+        sum += cell.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+size_t ShardedCounter::threadSlot() {
+    static std::atomic<size_t> nextSlot{0};
+    thread_local const size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % cellCount;
+    return slot;
+}
+
+const char* scanStageName(ScanStage stage) {
+    switch (stage) {
+    case ScanStage::Walk:
+        return "walk";
+    case ScanStage::Group:
+        return "group";
+    case ScanStage::Hash:
+        return "hash";
+    case ScanStage::Compare:
+        return "compare";
+    default:
+        return "finish";
+    }
+}
+
+std::string ScanMetrics::progressLine() const {
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1) << '[' << scanStageName(static_cast<ScanStage>(stage.load(std::memory_order_relaxed))) << ' '
+         << elapsedMillis(*this) / 1000.0 << "s] " << directories.load() << " dirs, " << filesSeen.load() << " files seen, "
+         << filesFiltered.load() << " filtered, " << filesHashed.load() << " hashed, " << bytesRead.load() / bytesPerMiB << " MiB read, "
+         << blocksHashed.load() << " blocks, " << groups.load() << " groups";
+    return line.str();
+}
+
+void ScanMetrics::writeSummary(std::ostream& out) const {
+    std::ostringstream summary;
+    summary << std::fixed << std::setprecision(1) << "Scan finished in " << elapsedMillis(*this) / 1000.0 << " s\n";
+    for (size_t i = 0; i < stageNanos.size(); ++i) {
+        summary << "  " << std::left << std::setw(8) << scanStageName(static_cast<ScanStage>(i)) << std::right << std::setw(10)
+                << stageNanos[i].load() / nanosPerMilli << " ms\n";
+    }
+    summary << "  verify and output in workers: " << verifyNanos.load() / nanosPerMilli << " ms, " << outputNanos.load() / nanosPerMilli << " ms\n"
+            << "  " << directories.load() << " directories, " << filesSeen.load() << " files seen, " << filesFiltered.load() << " filtered, "
+            << candidates.load() << " candidates\n"
+            << "  " << directoriesReused.load() << " directories and " << sizesReused.load() << " file sizes taken from the snapshot\n"
+            << "  " << candidatesSpilled.load() << " files spilled to disk, " << throttleNanos.load() / nanosPerMilli << " ms waiting for the read rate limit\n"
+            << "  " << filesHashed.load() << " files hashed, " << bytesRead.load() / bytesPerMiB << " MiB read, " << blocksHashed.load() << " blocks hashed\n"
+            << "  " << groups.load() << " duplicate groups with " << duplicateFiles.load() << " files\n";
+    out << summary.str() << std::flush;
+}
+
+void ScanMetrics::writeJson(std::ostream& out) const {
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3) << "{\"elapsed_ms\":" << elapsedMillis(*this) << ",\"stages_ms\":{";
+    for (size_t i = 0; i < stageNanos.size(); ++i) {
+        json << (i > 0 ? "," : "") << '"' << scanStageName(static_cast<ScanStage>(i)) << "\":" << stageNanos[i].load() / nanosPerMilli;
+    }
+    json << "},\"verify_ms\":" << verifyNanos.load() / nanosPerMilli << ",\"output_ms\":" << outputNanos.load() / nanosPerMilli
+         << ",\"directories\":" << directories.load() << ",\"files_seen\":" << filesSeen.load() << ",\"files_filtered\":" << filesFiltered.load()
+         << ",\"candidates\":" << candidates.load() << ",\"directories_reused\":" << directoriesReused.load() << ",\"sizes_reused\":" << sizesReused.load()
+         << ",\"files_spilled\":" << candidatesSpilled.load() << ",\"throttle_ms\":" << throttleNanos.load() / nanosPerMilli
+         << ",\"files_hashed\":" << filesHashed.load() << ",\"bytes_read\":" << bytesRead.load()
+         << ",\"blocks_hashed\":" << blocksHashed.load() << ",\"groups\":" << groups.load() << ",\"duplicate_files\":" << duplicateFiles.load() << "}\n";
+    out << json.str() << std::flush;
+}
+
+StageTimer::StageTimer(ScanMetrics& metrics, ScanStage stage) : metrics_(metrics), stage_(stage), start_(std::chrono::steady_clock::now()) {
+    metrics_.stage.store(static_cast<int>(stage), std::memory_order_relaxed);
+}
+
+void StageTimer::next(ScanStage stage) {
+    stop();
+    stage_ = stage;
+    start_ = std::chrono::steady_clock::now();
+    running_ = true;
+    metrics_.stage.store(static_cast<int>(stage), std::memory_order_relaxed);
+}
+
+void StageTimer::stop() {
+    if (running_) {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        metrics_.stageNanos[static_cast<size_t>(stage_)].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), std::memory_order_relaxed);
+        running_ = false;
+    }
+}
+
+ProgressReporter::ProgressReporter(const ScanMetrics& metrics, std::ostream& out, std::chrono::milliseconds interval) : metrics_(metrics), out_(out) {
+    thread_ = std::thread([this, interval] {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopped_.wait_for(lock, interval, [this] { return stopping_; })) {
+            out_ << metrics_.progressLine() << std::endl;
+        }
+    });
+}
+
+ProgressReporter::~ProgressReporter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    stopped_.notify_all();
+    thread_.join();
+}
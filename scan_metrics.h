@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+// Счетчик, разнесенный по строкам кэша: каждый поток увеличивает свою ячейку без синхронизации с другими,
+// чтение суммирует все ячейки (значение может отставать от текущего на незавершенные увеличения)
+class ShardedCounter {
+public:
+    void add(uint64_t value) { cells_[threadSlot()].value.fetch_add(value, std::memory_order_relaxed); }
+    uint64_t load() const;
+
+private:
+    static constexpr size_t cellCount = 32;
+    struct alignas(64) Cell {
+        std::atomic<uint64_t> value{0};
+    };
+
+    static size_t threadSlot(); // ячейка текущего потока (назначается при первом обращении)
+
+    std::array<Cell, cellCount> cells_;
+};
+
+// Этап поиска дубликатов
+enum class ScanStage {
+    Walk, // обход директорий
+    Group, // группировка кандидатов по размеру и inode
+    Hash, // хэширование первых блоков
+    Compare, // сравнение групп по хэшам, проверка и вывод
+    Finish, // сохранение кэша и завершение вывода
+    Count
+};
+
+// Счетчики и время этапов одного поиска
+struct ScanMetrics {
+    ShardedCounter directories; // прочитанные директории
+    ShardedCounter directoriesReused; // директории, содержимое которых взято из снимка без чтения
+    ShardedCounter filesSeen; // обычные файлы, встреченные при обходе
+    ShardedCounter filesFiltered; // файлы, отброшенные масками и минимальным размером
+    ShardedCounter candidates; // файлы с размером, встречающимся больше одного раза
+    ShardedCounter sizesReused; // размеры без изменений, группы которых взяты из снимка
+    ShardedCounter candidatesSpilled; // файлы, вынесенные во временные файлы при превышении бюджета памяти
+    ShardedCounter filesHashed; // файлы, из которых прочитан хотя бы один блок
+    ShardedCounter bytesRead; // байты, прочитанные для хэширования и проверки
+    ShardedCounter blocksHashed; // вычисленные хэши блоков
+    ShardedCounter groups; // найденные группы дубликатов
+    ShardedCounter duplicateFiles; // файлы в найденных группах
+    ShardedCounter verifyNanos; // суммарное время проверки групп во всех потоках
+    ShardedCounter outputNanos; // суммарное время вывода групп во всех потоках
+    ShardedCounter throttleNanos; // суммарное время ожидания ограничения скорости чтения во всех потоках
+    std::array<std::atomic<int64_t>, static_cast<size_t>(ScanStage::Count)> stageNanos{}; // длительность каждого этапа
+    std::atomic<int> stage{static_cast<int>(ScanStage::Walk)}; // текущий этап
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now(); // начало поиска
+
+    // Строка текущего состояния для периодического отчета
+    std::string progressLine() const;
+    // Итоговая сводка в читаемом виде
+    void writeSummary(std::ostream& out) const;
+    // Итоговые значения в формате JSON (одна строка)
+    void writeJson(std::ostream& out) const;
+};
+
+// Функция для получения названия этапа
+const char* scanStageName(ScanStage stage);
+
+// Замер этапов: при создании этап становится текущим, при переходе к следующему этапу, остановке или уничтожении
+// длительность завершенного этапа добавляется к stageNanos
+class StageTimer {
+public:
+    StageTimer(ScanMetrics& metrics, ScanStage stage);
+    ~StageTimer() { stop(); }
+
+    // Завершение текущего этапа и начало следующего
+    void next(ScanStage stage);
+    // Завершение текущего этапа без начала следующего
+    void stop();
+
+private:
+    ScanMetrics& metrics_;
+    ScanStage stage_;
+    std::chrono::steady_clock::time_point start_;
+    bool running_ = true; // текущий этап еще не завершен
+};
+
+// Замер времени участка, добавляемого к счетчику (например, проверки групп в рабочих потоках)
+class ScopedNanos {
+public:
+    explicit ScopedNanos(ShardedCounter& counter) : counter_(counter), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedNanos() { counter_.add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count())); }
+
+private:
+    ShardedCounter& counter_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Поток периодического отчета: раз в interval выводит строку состояния в out, пока объект не уничтожен
+class ProgressReporter {
+public:
+    ProgressReporter(const ScanMetrics& metrics, std::ostream& out, std::chrono::milliseconds interval);
+    ~ProgressReporter();
+
+private:
+    const ScanMetrics& metrics_;
+    std::ostream& out_;
+    std::mutex mutex_;
+    std::condition_variable stopped_;
+    bool stopping_ = false;
+    std::thread thread_;
+};
@@ -0,0 +1,355 @@
+#include "scan_snapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char snapshotMagic[4] = {'L', '7', 'S', 'N'};
+constexpr uint32_t snapshotVersion = 1; // версия формата, увеличивается при любом его изменении
+// Изменение вскоре после чтения метаданных может не изменить время изменения (его точность ограничена),
+// поэтому время изменения ближе этого к началу поиска не считается надежным
+constexpr int64_t racyNanos = 2000000000;
+
+using NativeString = fs::path::string_type;
+
+// Последовательная запись снимка
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(std::ostream& out) : out_(out) {}
+
+    template <typename T>
+    void value(const T& item) {
+        out_.write(reinterpret_cast<const char*>(&item), sizeof(item));
+    }
+
+    template <typename Char>
+    void string(std::basic_string_view<Char> text) {
+        value<uint64_t>(text.size());
+        out_.write(reinterpret_cast<const char*>(text.data()), static_cast<std::streamsize>(text.size() * sizeof(Char)));
+    }
+
+private:
+    std::ostream& out_;
+};
+
+// Последовательное чтение снимка с проверкой размеров по оставшейся длине файла (поврежденный снимок не вызывает больших выделений памяти)
+class SnapshotReader {
+public:
+    SnapshotReader(std::istream& in, uint64_t size) : in_(in), remaining_(size) {}
+
+    template <typename T>
+    bool value(T& item) {
+        return bytes(&item, sizeof(item));
+    }
+
+    // Количество элементов, каждый из которых занимает не меньше itemBytes байтов
+    bool count(uint64_t& items, size_t itemBytes) {
+        return value(items) && items <= remaining_ / itemBytes;
+    }
+
+    template <typename Char>
+    bool string(std::basic_string<Char>& text) {
+        uint64_t length = 0;
+        if (!count(length, sizeof(Char))) {
+            return false;
+        }
+        text.resize(static_cast<size_t>(length));
+        return bytes(&text[0], static_cast<size_t>(length) * sizeof(Char));
+    }
+
+    bool bytes(void* data, size_t size) {
+        if (size > remaining_ || !in_.read(static_cast<char*>(data), static_cast<std::streamsize>(size))) {
+            return false;
+        }
+        remaining_ -= size;
+        return true;
+    }
+
+    bool atEnd() const { return remaining_ == 0; }
+
+private:
+    std::istream& in_;
+    uint64_t remaining_; // непрочитанные байты файла
+};
+
+// Функция для получения ключа директории: путь с завершающим разделителем, как его хранит таблица кандидатов
+NativeString directoryKey(const fs::path& directory) {
+    return (directory / "").native();
+}
+
+// Функция для получения текущего времени в наносекундах с начала эпохи
+int64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+ScanSnapshot::ScanSnapshot(std::string fingerprint) : fingerprint_(std::move(fingerprint)), startTime_(nowNanos()) {}
+
+void ScanSnapshot::begin() {
+    startTime_ = nowNanos();
+}
+
+bool ScanSnapshot::load(const fs::path& snapshotPath) {
+    std::error_code error;
+    uint64_t size = fs::file_size(snapshotPath, error);
+    if (error) { // снимка еще нет
+        return false;
+    }
+    std::ifstream in(snapshotPath, std::ios::binary);
+    SnapshotReader reader(in, size);
+    char magic[4];
+    uint32_t version = 0;
+    std::string fingerprint;
+    bool valid = reader.bytes(magic, sizeof(magic)) && std::memcmp(magic, snapshotMagic, sizeof(magic)) == 0 && reader.value(version) &&
+                 version == snapshotVersion && reader.value(previousStartTime_) && reader.string(fingerprint);
+    if (valid && fingerprint != fingerprint_) {
+        std::cerr << "Snapshot was made with different settings, scanning from scratch: " << snapshotPath << std::endl;
+        return false;
+    }
+    std::vector<Directory> directories;
+    uint64_t directoryCount = 0;
+    valid = valid && reader.count(directoryCount, 32);
+    for (uint64_t i = 0; valid && i < directoryCount; ++i) {
+        Directory directory;
+        uint64_t subdirectoryCount = 0;
+        uint64_t fileCount = 0;
+        valid = reader.string(directory.path) && reader.value(directory.mtime) && reader.count(subdirectoryCount, sizeof(uint64_t));
+        for (uint64_t j = 0; valid && j < subdirectoryCount; ++j) {
+            directory.subdirectories.emplace_back();
+            valid = reader.string(directory.subdirectories.back());
+        }
+        valid = valid && reader.count(fileCount, 48);
+        for (uint64_t j = 0; valid && j < fileCount; ++j) {
+            NativeString name;
+            FileMetadata metadata;
+            uint32_t group = 0;
+            uint64_t hashCount = 0;
+            valid = reader.string(name) && reader.value(metadata.size) && reader.value(metadata.device) && reader.value(metadata.inode) &&
+                    reader.value(metadata.mtime) && reader.value(group) && reader.count(hashCount, sizeof(uint32_t));
+            std::vector<uint32_t> hashes(valid ? static_cast<size_t>(hashCount) : 0);
+            valid = valid && reader.bytes(hashes.data(), hashes.size() * sizeof(uint32_t)) && (directory.names.empty() || directory.names.back() < name);
+            directory.names.push_back(std::move(name));
+            directory.metadata.push_back(metadata);
+            directory.groups.push_back(group);
+            directory.hashes.push_back(std::move(hashes));
+        }
+        directories.push_back(std::move(directory));
+    }
+    if (!valid || !reader.atEnd()) {
+        std::cerr << "Ignoring invalid snapshot: " << snapshotPath << std::endl;
+        return false;
+    }
+    setPrevious(std::move(directories));
+    return true;
+}
+
+void ScanSnapshot::setPrevious(std::vector<Directory> directories) {
+    previous_ = std::move(directories);
+    previousIndex_.clear();
+    previousCount_ = 0;
+    for (size_t i = 0; i < previous_.size(); ++i) {
+        previous_[i].firstFile = previousCount_;
+        previousCount_ += previous_[i].names.size();
+        previousIndex_.emplace(previous_[i].path, i);
+    }
+    loaded_ = true;
+}
+
+bool ScanSnapshot::find(const fs::path& directory, int64_t mtime, DirectoryListing& listing) const {
+    auto it = previousIndex_.find(directoryKey(directory));
+    if (it == previousIndex_.end() || previous_[it->second].mtime != mtime) {
+        return false;
+    }
+    const Directory& previous = previous_[it->second];
+    listing.mtime = mtime;
+    listing.subdirectories = previous.subdirectories;
+    listing.files.clear();
+    for (size_t i = 0; i < previous.names.size(); ++i) {
+        listing.files.push_back({previous.names[i], previous.metadata[i]});
+    }
+    reused_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void ScanSnapshot::record(const fs::path& directory, DirectoryListing listing) {
+    std::sort(listing.files.begin(), listing.files.end(), [](const ListedFile& left, const ListedFile& right) { return left.name < right.name; });
+    Directory next;
+    next.path = directoryKey(directory);
+    next.mtime = listing.mtime;
+    next.subdirectories = std::move(listing.subdirectories);
+    for (auto& file : listing.files) {
+        next.names.push_back(std::move(file.name));
+        next.metadata.push_back(file.metadata);
+    }
+    next.groups.resize(next.names.size(), 0);
+    next.hashes.resize(next.names.size());
+    std::lock_guard<std::mutex> lock(mutex_);
+    next_.push_back(std::move(next));
+}
+
+size_t ScanSnapshot::previousDirectory(NativeName directory) const {
+    auto it = previousIndex_.find(NativeString(directory));
+    return it == previousIndex_.end() ? SIZE_MAX : it->second;
+}
+
+ScanSnapshot::PreviousFile ScanSnapshot::previous(size_t directory, NativeName name) const {
+    PreviousFile file;
+    size_t position = 0;
+    if (directory < previous_.size() && findName(previous_[directory], name, position)) {
+        const Directory& previous = previous_[directory];
+        file.index = previous.firstFile + position;
+        file.metadata = previous.metadata[position];
+        if (file.metadata.mtime >= previousStartTime_ - racyNanos) { // файл мог измениться после чтения, не поменяв время изменения
+            file.metadata.mtime = INT64_MIN;
+        }
+        file.group = previous.groups[position];
+        file.hashes = &previous.hashes[position];
+    }
+    return file;
+}
+
+void ScanSnapshot::forEachPrevious(const std::function<void(const PreviousFile& file)>& onFile) const {
+    for (const auto& directory : previous_) {
+        for (size_t i = 0; i < directory.names.size(); ++i) {
+            onFile({directory.firstFile + i, directory.metadata[i], directory.groups[i], &directory.hashes[i]});
+        }
+    }
+}
+
+bool ScanSnapshot::findName(const Directory& directory, NativeName name, size_t& position) {
+    auto it = std::lower_bound(directory.names.begin(), directory.names.end(), name, [](const NativeString& item, NativeName value) { return NativeName(item) < value; });
+    position = static_cast<size_t>(it - directory.names.begin());
+    return it != directory.names.end() && NativeName(*it) == name;
+}
+
+ScanSnapshot::Directory& ScanSnapshot::nextDirectory(NativeName directory) {
+    if (!nextIndexed_) { // обход завершен, записи директорий больше не добавляются из потоков обхода
+        for (size_t i = 0; i < next_.size(); ++i) {
+            nextIndex_.emplace(next_[i].path, i);
+        }
+        nextIndexed_ = true;
+    }
+    if (lastNext_ < next_.size() && NativeName(next_[lastNext_].path) == directory) {
+        return next_[lastNext_];
+    }
+    auto inserted = nextIndex_.emplace(NativeString(directory), next_.size());
+    if (inserted.second) { // файл получен не из обхода с записью содержимого директорий: директорию нужно будет прочитать
+        next_.emplace_back();
+        next_.back().path = NativeString(directory);
+        next_.back().mtime = INT64_MIN;
+    }
+    lastNext_ = inserted.first->second;
+    return next_[lastNext_];
+}
+
+void ScanSnapshot::update(NativeName directory, NativeName name, const FileMetadata& metadata, uint32_t group, std::vector<uint32_t> hashes) {
+    Directory& next = nextDirectory(directory);
+    size_t position = 0;
+    if (!findName(next, name, position)) {
+        next.names.emplace(next.names.begin() + position, name);
+        next.metadata.emplace(next.metadata.begin() + position);
+        next.groups.emplace(next.groups.begin() + position);
+        next.hashes.emplace(next.hashes.begin() + position);
+    }
+    next.metadata[position] = metadata;
+    next.groups[position] = group;
+    next.hashes[position] = std::move(hashes);
+}
+
+void ScanSnapshot::remove(NativeName directory, NativeName name) {
+    Directory& next = nextDirectory(directory);
+    size_t position = 0;
+    if (findName(next, name, position)) {
+        next.names.erase(next.names.begin() + position);
+        next.metadata.erase(next.metadata.begin() + position);
+        next.groups.erase(next.groups.begin() + position);
+        next.hashes.erase(next.hashes.begin() + position);
+    }
+}
+
+void ScanSnapshot::save(const fs::path& snapshotPath) {
+    fs::path temporaryPath = snapshotPath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        SnapshotWriter writer(out);
+        out.write(snapshotMagic, sizeof(snapshotMagic));
+        writer.value(snapshotVersion);
+        writer.value(startTime_);
+        writer.string(std::string_view(fingerprint_));
+        writer.value<uint64_t>(next_.size());
+        for (const auto& directory : next_) {
+            writer.string(NativeName(directory.path));
+            writer.value(trustedMtime(directory));
+            writer.value<uint64_t>(directory.subdirectories.size());
+            for (const auto& name : directory.subdirectories) {
+                writer.string(NativeName(name));
+            }
+            writer.value<uint64_t>(directory.names.size());
+            for (size_t i = 0; i < directory.names.size(); ++i) {
+                writer.string(NativeName(directory.names[i]));
+                writer.value(directory.metadata[i].size);
+                writer.value(directory.metadata[i].device);
+                writer.value(directory.metadata[i].inode);
+                writer.value(directory.metadata[i].mtime);
+                writer.value(directory.groups[i]);
+                writer.value<uint64_t>(directory.hashes[i].size());
+                out.write(reinterpret_cast<const char*>(directory.hashes[i].data()), static_cast<std::streamsize>(directory.hashes[i].size() * sizeof(uint32_t)));
+            }
+        }
+        if (!out.flush()) {
+            std::cerr << "Cannot write snapshot: " << temporaryPath << std::endl;
+            out.close();
+            std::error_code error;
+            fs::remove(temporaryPath, error);
+            return;
+        }
+    }
+    std::error_code error;
+    fs::rename(temporaryPath, snapshotPath, error);
+    if (error) {
+        std::cerr << "Cannot replace snapshot " << snapshotPath << ": " << error.message() << std::endl;
+        fs::remove(temporaryPath, error);
+    }
+}
+
+int64_t ScanSnapshot::trustedMtime(const Directory& directory) const {
+    return directory.mtime >= startTime_ - racyNanos ? INT64_MIN : directory.mtime;
+}
+
+void ScanSnapshot::advance() {
+    for (auto& directory : next_) {
+        directory.mtime = trustedMtime(directory);
+    }
+    setPrevious(std::move(next_));
+    previousStartTime_ = startTime_;
+    next_.clear();
+    nextIndex_.clear();
+    nextIndexed_ = false;
+    lastNext_ = 0;
+    reused_.store(0, std::memory_order_relaxed);
+}
+
+void ScanSnapshot::invalidate(const fs::path& directory) {
+    auto it = previousIndex_.find(directoryKey(directory));
+    if (it != previousIndex_.end()) {
+        previous_[it->second].mtime = INT64_MIN;
+    }
+}
+
+std::vector<fs::path> ScanSnapshot::directories() const {
+    std::vector<fs::path> paths;
+    paths.reserve(previous_.size());
+    for (const auto& directory : previous_) {
+        paths.emplace_back(directory.path);
+    }
+    return paths;
+}
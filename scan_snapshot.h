@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "directory_walker.h"
+
+// Снимок поиска для инкрементального повторного поиска: содержимое всех директорий, метаданные и вычисленные хэши блоков
+// файлов и номера групп дубликатов, в которые они вошли.
+// Формат файла (порядок байтов узла): заголовок {"L7SN", версия, время начала поиска, описание параметров поиска},
+// затем записи директорий {путь, время изменения, имена поддиректорий, файлы {имя, метаданные, номер группы, хэши}}
+class ScanSnapshot : public ListingStore {
+public:
+    // Файл прошлого поиска
+    struct PreviousFile {
+        size_t index = SIZE_MAX; // сквозной номер файла в снимке (SIZE_MAX - файла в снимке нет)
+        FileMetadata metadata; // метаданные при прошлом поиске
+        uint32_t group = 0; // номер группы дубликатов (0 - файл не входил в группы)
+        const std::vector<uint32_t>* hashes = nullptr; // вычисленные хэши блоков
+    };
+
+    // fingerprint - описание параметров поиска: снимок с другими параметрами не используется
+    explicit ScanSnapshot(std::string fingerprint);
+
+    // Загрузка снимка прошлого поиска; отсутствующий, поврежденный или сделанный с другими параметрами снимок не загружается
+    bool load(const std::filesystem::path& snapshotPath);
+    bool loaded() const { return loaded_; }
+    const std::string& fingerprint() const { return fingerprint_; }
+    // Начало очередного поиска с тем же снимком (конструктор отмечает начало первого): по нему решается, каким временам изменения можно доверять
+    void begin();
+
+    // Сохраненное содержимое директории (для обхода); метаданные файлов обход запрашивает заново
+    bool find(const std::filesystem::path& directory, int64_t mtime, DirectoryListing& listing) const override;
+    // Запоминание содержимого директории для следующего снимка
+    void record(const std::filesystem::path& directory, DirectoryListing listing) override;
+    size_t reusedDirectories() const { return reused_.load(std::memory_order_relaxed); } // директории, взятые из снимка
+
+    // Номер директории прошлого поиска по пути с завершающим разделителем (SIZE_MAX - директории в снимке нет)
+    size_t previousDirectory(NativeName directory) const;
+    // Файл прошлого поиска по номеру директории и имени; время изменения, слишком близкое к началу прошлого поиска,
+    // заменяется на INT64_MIN, чтобы файл считался измененным
+    PreviousFile previous(size_t directory, NativeName name) const;
+    // Количество файлов прошлого поиска
+    size_t previousCount() const { return previousCount_; }
+    // Перебор всех файлов прошлого поиска
+    void forEachPrevious(const std::function<void(const PreviousFile& file)>& onFile) const;
+
+    // Сохранение метаданных, номера группы и хэшей файла в следующем снимке (после обхода, из одного потока)
+    void update(NativeName directory, NativeName name, const FileMetadata& metadata, uint32_t group, std::vector<uint32_t> hashes);
+    // Удаление файла, исчезнувшего после обхода, из следующего снимка
+    void remove(NativeName directory, NativeName name);
+    // Атомарная запись следующего снимка: данные пишутся во временный файл, который затем переименовывается
+    void save(const std::filesystem::path& snapshotPath);
+    // Переход к следующему поиску без записи в файл: следующий снимок становится прошлым (как после save и load)
+    void advance();
+
+    // Директория, изменение которой известно заранее (например, из уведомлений файловой системы): при следующем обходе
+    // она читается заново, даже если время ее изменения осталось прежним
+    void invalidate(const std::filesystem::path& directory);
+    // Пути всех директорий прошлого поиска с завершающим разделителем
+    std::vector<std::filesystem::path> directories() const;
+
+private:
+    // Директория снимка; файлы отсортированы по имени
+    struct Directory {
+        std::filesystem::path::string_type path; // путь с завершающим разделителем
+        int64_t mtime = 0; // время изменения (INT64_MIN - директорию нужно прочитать заново)
+        std::vector<std::filesystem::path::string_type> subdirectories;
+        std::vector<std::filesystem::path::string_type> names;
+        std::vector<FileMetadata> metadata;
+        std::vector<uint32_t> groups;
+        std::vector<std::vector<uint32_t>> hashes;
+        size_t firstFile = 0; // сквозной номер первого файла
+    };
+
+    using DirectoryIndex = std::unordered_map<std::filesystem::path::string_type, size_t>;
+
+    // Директория следующего снимка (создается при первом обращении)
+    Directory& nextDirectory(NativeName directory);
+    // Номер файла в директории; false - файла нет, position - место для вставки
+    static bool findName(const Directory& directory, NativeName name, size_t& position);
+    // Время изменения директории для следующего поиска: слишком близкое к началу этого поиска не сохраняется
+    int64_t trustedMtime(const Directory& directory) const;
+    // Замена прошлого снимка с пересчетом сквозных номеров файлов и индекса директорий
+    void setPrevious(std::vector<Directory> directories);
+
+    std::string fingerprint_; // описание параметров поиска
+    int64_t startTime_; // начало этого поиска (наносекунды с начала эпохи)
+    int64_t previousStartTime_ = 0; // начало прошлого поиска
+    bool loaded_ = false;
+    std::vector<Directory> previous_; // снимок прошлого поиска
+    DirectoryIndex previousIndex_;
+    size_t previousCount_ = 0;
+    std::mutex mutex_;
+    std::vector<Directory> next_; // следующий снимок
+    DirectoryIndex nextIndex_; // строится после обхода, при первом обновлении файла
+    bool nextIndexed_ = false;
+    size_t lastNext_ = 0; // последняя найденная директория (файлы одной директории обновляются подряд)
+    mutable std::atomic<size_t> reused_{0};
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Потоковое вычисление SHA-256 (FIPS 180-4)
+class Sha256 {
+public:
+    using Digest = std::array<unsigned char, 32>;
+
+    Sha256();
+
+    // Добавление данных
+    void update(const unsigned char* data, size_t size);
+    // Завершение вычисления; после вызова объект нужно пересоздать
+    Digest finish();
+
+private:
+    void compress(const unsigned char* block);
+
+    std::array<uint32_t, 8> state_; // промежуточное значение хэша
+    std::array<unsigned char, 64> buffer_; // неполный блок
+    size_t buffered_ = 0; // количество байтов в buffer_
+    uint64_t length_ = 0; // общая длина данных в байтах
+};
@@ -0,0 +1,44 @@
+# Проверка распределенного поиска: два узла пишут индексы размеров, слияние дает список размеров, узлы пишут индексы хэшей,
+# слияние дает группы. Группы должны совпадать с поиском на одной машине по тем же директориям (без префиксов узлов).
+# Параметры (-D): LAB07 - программа, CORPUS - программа lab07_corpus, DIRECTORY - рабочая директория (создается заново)
+
+file(REMOVE_RECURSE "${DIRECTORY}")
+execute_process(COMMAND "${CORPUS}" -n 300 --min-size 1024 --max-size 65536 "${DIRECTORY}/corpus" RESULT_VARIABLE result OUTPUT_QUIET)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "lab07_corpus failed: ${result}")
+endif()
+set(root "${DIRECTORY}/corpus/g0")
+set(nodeA "${root}/d0" "${root}/d1")
+set(nodeB "${root}/d2" "${root}/d3" "${root}/d4")
+
+# Функция для запуска lab07 с аргументами ARGN; вывод сохраняется в output
+function(run_lab07 output)
+    execute_process(COMMAND "${LAB07}" ${ARGN} RESULT_VARIABLE result OUTPUT_VARIABLE text ERROR_VARIABLE errors)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "lab07 ${ARGN} failed (${result}): ${errors}")
+    endif()
+    set(${output} "${text}" PARENT_SCOPE)
+endfunction()
+
+run_lab07(ignored --partial-index "${DIRECTORY}/a.sizes" --node A ${nodeA})
+run_lab07(ignored --partial-index "${DIRECTORY}/b.sizes" --node B ${nodeB})
+run_lab07(sizes --merge "${DIRECTORY}/a.sizes" "${DIRECTORY}/b.sizes")
+file(WRITE "${DIRECTORY}/sizes.txt" "${sizes}")
+run_lab07(ignored --partial-index "${DIRECTORY}/a.hashes" --node A --index-sizes "${DIRECTORY}/sizes.txt" ${nodeA})
+run_lab07(ignored --partial-index "${DIRECTORY}/b.hashes" --node B --index-sizes "${DIRECTORY}/sizes.txt" ${nodeB})
+run_lab07(merged --merge "${DIRECTORY}/a.hashes" "${DIRECTORY}/b.hashes")
+run_lab07(local ${nodeA} ${nodeB})
+
+if(merged MATCHES "\"[AB]:\"")
+    message(FATAL_ERROR "Merged groups contain empty paths:\n${merged}")
+endif()
+string(REGEX MATCHALL "\n\n" separators "\n${merged}")
+list(LENGTH separators groups)
+if(groups EQUAL 0)
+    message(FATAL_ERROR "Merged index has no groups")
+endif()
+string(REGEX REPLACE "\n\"[AB]:" "\n\"" stripped "\n${merged}")
+if(NOT stripped STREQUAL "\n${local}")
+    message(FATAL_ERROR "Merged groups differ from the local scan:\n${merged}\n---\n${local}")
+endif()
+message(STATUS "${groups} groups match the local scan")
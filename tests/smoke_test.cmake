@@ -0,0 +1,44 @@
+# Проверка lab07 на наборе файлов: количество групп дубликатов и путей в них, одинаковый вывод при разном числе потоков.
+# Параметры (-D): LAB07 - программа, DIRECTORY - директория поиска; EXPECTED_GROUPS и EXPECTED_FILES - ожидаемые количества,
+# либо CORPUS - программа lab07_corpus: набор создается в DIRECTORY, и путей в группах должно быть на число копий больше, чем групп
+
+if(CORPUS)
+    file(REMOVE_RECURSE "${DIRECTORY}")
+    execute_process(COMMAND "${CORPUS}" -n 300 --min-size 1024 --max-size 65536 "${DIRECTORY}" RESULT_VARIABLE result OUTPUT_VARIABLE summary)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "lab07_corpus failed: ${result}")
+    endif()
+    if(NOT summary MATCHES "([0-9]+) duplicates")
+        message(FATAL_ERROR "Unexpected lab07_corpus output: ${summary}")
+    endif()
+    set(copies ${CMAKE_MATCH_1})
+endif()
+
+# Функция для поиска дубликатов с threads потоками: вывод в текстовом формате
+function(run_lab07 threads output)
+    execute_process(COMMAND "${LAB07}" -j ${threads} "${DIRECTORY}" RESULT_VARIABLE result OUTPUT_VARIABLE text ERROR_VARIABLE errors)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "lab07 -j ${threads} failed (${result}): ${errors}")
+    endif()
+    set(${output} "${text}" PARENT_SCOPE)
+endfunction()
+
+run_lab07(1 single)
+run_lab07(8 parallel)
+if(NOT single STREQUAL parallel)
+    message(FATAL_ERROR "Output differs between -j 1 and -j 8:\n${single}\n---\n${parallel}")
+endif()
+
+# Каждая группа начинается пустой строкой, каждый путь - отдельная строка в кавычках
+string(REGEX MATCHALL "\n\n" separators "\n${single}")
+string(REGEX MATCHALL "\n\"" paths "\n${single}")
+list(LENGTH separators groups)
+list(LENGTH paths files)
+if(CORPUS)
+    math(EXPR EXPECTED_GROUPS "${files} - ${copies}")
+    set(EXPECTED_FILES ${files})
+endif()
+if(NOT groups EQUAL EXPECTED_GROUPS OR NOT files EQUAL EXPECTED_FILES)
+    message(FATAL_ERROR "Expected ${EXPECTED_GROUPS} groups with ${EXPECTED_FILES} files, found ${groups} groups with ${files} files:\n${single}")
+endif()
+message(STATUS "${groups} groups, ${files} files")